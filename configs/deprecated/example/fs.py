@@ -53,6 +53,7 @@ from gem5.runtime import get_runtime_isa
 addToPath("../../")
 
 from ruby import Ruby
+from network import Network
 
 from common.FSConfig import *
 from common.SysPaths import *
@@ -409,6 +410,9 @@ if ObjectList.is_kvm_cpu(TestCPUClass) or ObjectList.is_kvm_cpu(FutureClass):
     # Note: The simulator is quite picky about this number!
     root.sim_quantum = int(1e9)  # 1 ms
 
+if args.ruby:
+    Network.set_sim_quantum(args, root, test_sys.ruby.network)
+
 if args.timesync:
     root.time_sync_enable = True
 
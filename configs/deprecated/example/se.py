@@ -55,6 +55,7 @@ from gem5.runtime import get_runtime_isa
 addToPath("../../")
 
 from ruby import Ruby
+from network import Network
 
 from common import Options
 from common import Simulation
@@ -289,4 +290,8 @@ if args.wait_gdb:
     system.workload.wait_for_remote_gdb = True
 
 root = Root(full_system=False, system=system)
+
+if args.ruby:
+    Network.set_sim_quantum(args, root, system.ruby.network)
+
 Simulation.run(args, root, system, FutureClass)
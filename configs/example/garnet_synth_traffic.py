@@ -36,6 +36,7 @@ addToPath("../")
 
 from common import Options
 from ruby import Ruby
+from network import Network
 
 # Get paths we might need.  It's expected this file is in m5/configs/example.
 config_path = os.path.dirname(os.path.abspath(__file__))
@@ -172,6 +173,8 @@ for ruby_port in system.ruby._cpu_ports:
 root = Root(full_system=False, system=system)
 root.system.mem_mode = "timing"
 
+Network.set_sim_quantum(args, root, system.ruby.network)
+
 # Not much point in this being higher than the L1 latency
 m5.ticks.setGlobalFrequency(
     "500ps"
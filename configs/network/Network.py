@@ -29,6 +29,7 @@ import m5
 from m5.objects import *
 from m5.defines import buildEnv
 from m5.util import addToPath, fatal, warn
+from m5.util.convert import toFrequency
 
 
 def define_options(parser):
@@ -65,6 +66,14 @@ def define_options(parser):
         choices=["simple", "garnet"],
         help="""'simple'|'garnet' (garnet2.0 will be deprecated.)""",
     )
+    parser.add_argument(
+        "--routing-table-cache",
+        action="store",
+        type=str,
+        default="",
+        help="""directory in which the routing tables of each topology
+            are cached across runs. Disabled when empty.""",
+    )
     parser.add_argument(
         "--router-latency",
         action="store",
@@ -125,6 +134,39 @@ def define_options(parser):
         default=50000,
         help="network-level deadlock threshold.",
     )
+    parser.add_argument(
+        "--garnet-random-seed",
+        action="store",
+        type=int,
+        default=1,
+        help="""seed of the random streams of the garnet routers
+            (adaptive route and output selection).""",
+    )
+    parser.add_argument(
+        "--garnet-regions",
+        action="store",
+        type=int,
+        default=1,
+        help="""number of regions the garnet routers are split into.
+            Links between regions are the synchronization points of
+            --garnet-threads. The network interfaces all stay in region
+            0, see src/mem/ruby/network/garnet/README.txt.""",
+    )
+    parser.add_argument(
+        "--garnet-threads",
+        action="store",
+        type=int,
+        default=1,
+        help="""number of event queues (host threads) the garnet
+            regions are spread over. Results do not depend on it.""",
+    )
+    parser.add_argument(
+        "--cycle-driven",
+        action="store_true",
+        default=False,
+        help="""run the garnet network from one per-cycle loop
+            while it is dense, with event-driven wakeups otherwise.""",
+    )
     parser.add_argument(
         "--simple-physical-channels",
         action="store_true",
@@ -132,12 +174,74 @@ def define_options(parser):
         help="""SimpleNetwork links uses a separate physical
             channel for each virtual network""",
     )
+    parser.add_argument(
+        "--multicast",
+        action="store_true",
+        default=False,
+        help="""send multicast messages as one packet replicated by the
+            garnet routers instead of one packet per destination.""",
+    )
     parser.add_argument(
         "--wormhole",
         action="store_true",
         default=False,
         help="enable wormhole flow control.",
     )
+    parser.add_argument(
+        "--virtual-cut-through",
+        action="store_true",
+        default=False,
+        help="""enable virtual cut-through flow control: a head flit
+            only advances to a VC with room for the whole packet, and a
+            VC takes the next packet once the previous tail was sent.""",
+    )
+    parser.add_argument(
+        "--lookahead-routing",
+        action="store_true",
+        default=False,
+        help="""compute routes one hop ahead in the routers.
+            Saves one stage of the router pipeline.""",
+    )
+    parser.add_argument(
+        "--speculative-sa",
+        action="store_true",
+        default=False,
+        help="""allocate VCs speculatively in parallel with the switch.
+            Saves one stage of the router pipeline.""",
+    )
+    parser.add_argument(
+        "--torus-selection",
+        action="store",
+        type=str,
+        default="random",
+        choices=["random", "free_vcs", "credits", "regional"],
+        help="""selection among the legal outports of the 3D torus
+            routing (routing-algorithm=3).""",
+    )
+    parser.add_argument(
+        "--vc-classes",
+        action="store",
+        type=str,
+        default="",
+        help="""comma-separated class (escape or adaptive) of
+            each VC of a vnet, e.g. adaptive,adaptive,escape,escape.
+            Default: first half adaptive, second half escape.""",
+    )
+    parser.add_argument(
+        "--sa-policy",
+        action="store",
+        type=str,
+        default="separable",
+        choices=["separable", "islip", "wavefront", "matrix"],
+        help="switch allocation policy of the garnet routers.",
+    )
+    parser.add_argument(
+        "--sa-iterations",
+        action="store",
+        type=int,
+        default=1,
+        help="number of iterations of the islip switch allocator.",
+    )
     parser.add_argument(
         "--buffers-per-data-vc",
         action="store",
@@ -195,6 +299,37 @@ def create_network(options, ruby):
     return (network, IntLinkClass, ExtLinkClass, RouterClass, InterfaceClass)
 
 
+def router_region(options, network, router):
+    return router.router_id * options.garnet_regions // len(network.routers)
+
+
+def set_sim_quantum(options, root, network):
+    """The regions of a garnet network on several threads synchronize once
+    per simulation quantum, which must not exceed the latency of any link
+    between two regions. Sets root.sim_quantum to the lowest such latency,
+    replacing any quantum the config set before (e.g., for kvm cpus), or
+    leaves root alone if the network runs on a single thread. The network
+    interfaces are in region 0."""
+    if options.network != "garnet" or options.garnet_threads <= 1:
+        return
+
+    cross_latencies = [
+        int(intLink.latency)
+        for intLink in network.int_links
+        if router_region(options, network, intLink.src_node)
+        != router_region(options, network, intLink.dst_node)
+    ] + [
+        int(extLink.latency)
+        for extLink in network.ext_links
+        if router_region(options, network, extLink.int_node) != 0
+    ]
+    if not cross_latencies:
+        return
+
+    period_ps = 1e12 / toFrequency(options.ruby_clock)
+    root.sim_quantum = f"{int(min(cross_latencies) * period_ps)}ps"
+
+
 def init_network(options, network, InterfaceClass):
 
     if options.network == "garnet":
@@ -205,9 +340,21 @@ def init_network(options, network, InterfaceClass):
         network.ni_flit_size = options.link_width_bits / 8
         network.routing_algorithm = options.routing_algorithm
         network.garnet_deadlock_threshold = options.garnet_deadlock_threshold
+        network.random_seed = options.garnet_random_seed
         network.buffers_per_data_vc = options.buffers_per_data_vc
         network.buffers_per_ctrl_vc = options.buffers_per_ctrl_vc
+        network.multicast = options.multicast
         network.wormhole = options.wormhole
+        network.virtual_cut_through = options.virtual_cut_through
+        network.lookahead_routing = options.lookahead_routing
+        network.speculative_sa = options.speculative_sa
+        network.sa_policy = options.sa_policy
+        network.torus_selection = options.torus_selection
+        if options.vc_classes:
+            network.vc_classes = options.vc_classes.split(",")
+        network.sa_iterations = options.sa_iterations
+        network.num_regions = options.garnet_regions
+        network.cycle_driven = options.cycle_driven
 
         # Create Bridges and connect them to the corresponding links
         for intLink in network.int_links:
@@ -301,6 +448,32 @@ def init_network(options, network, InterfaceClass):
             )
             extLink.int_cred_bridge = int_cred_bridges
 
+        # Spread the regions over the event queues. The network interfaces
+        # stay on queue 0 with the controllers, and every link runs on the
+        # queue of the object that sends on it.
+        if options.garnet_threads > 1:
+            def router_queue(router):
+                region = router_region(options, network, router)
+                return region % options.garnet_threads
+
+            for router in network.routers:
+                router.eventq_index = router_queue(router)
+            for intLink in network.int_links:
+                intLink.network_link.eventq_index = router_queue(
+                    intLink.src_node
+                )
+                intLink.credit_link.eventq_index = router_queue(
+                    intLink.dst_node
+                )
+            for extLink in network.ext_links:
+                queue = router_queue(extLink.int_node)
+                extLink.network_links[0].eventq_index = 0
+                extLink.credit_links[0].eventq_index = queue
+                extLink.network_links[1].eventq_index = queue
+                extLink.credit_links[1].eventq_index = 0
+
+    network.routing_table_cache = options.routing_table_cache
+
     if options.network == "simple":
         if options.simple_physical_channels:
             network.physical_vnets_channels = [1] * int(
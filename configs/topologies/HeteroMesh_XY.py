@@ -0,0 +1,62 @@
+# Copyright (c) 2026 The gem5 contributors
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met: redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer;
+# redistributions in binary form must reproduce the above copyright
+# notice, this list of conditions and the following disclaimer in the
+# documentation and/or other materials provided with the distribution;
+# neither the name of the copyright holders nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+from m5.params import *
+from m5.objects import *
+
+from topologies.Mesh_XY import Mesh_XY
+
+# Creates the same mesh as Mesh_XY for HeteroGarnet, with the routers
+# in the odd columns supporting half the flit width of the network
+# interfaces. All links keep the full flit width, and SerDes units are
+# enabled at every link end that attaches to a narrow router.
+# Only supported by garnet.
+
+
+class HeteroMesh_XY(Mesh_XY):
+    description = "HeteroMesh_XY"
+
+    def makeTopology(self, options, network, IntLink, ExtLink, Router):
+        assert options.network == "garnet"
+
+        Mesh_XY.makeTopology(self, options, network, IntLink, ExtLink, Router)
+
+        ni_flit_size = options.link_width_bits // 8
+        num_columns = options.num_cpus // options.mesh_rows
+
+        # Narrow down the routers in the odd columns
+        narrow = set()
+        for router in network.routers:
+            if (router.router_id % num_columns) % 2 == 1:
+                router.width = ni_flit_size // 2
+                narrow.add(router.router_id)
+
+        for ext_link in network.ext_links:
+            ext_link.int_serdes = ext_link.int_node.router_id in narrow
+
+        for int_link in network.int_links:
+            int_link.src_serdes = int_link.src_node.router_id in narrow
+            int_link.dst_serdes = int_link.dst_node.router_id in narrow
@@ -124,6 +124,14 @@ GarnetSyntheticTraffic::init()
 }
 
 
+// No packet is generated while the system drains, so that the network
+// can deliver the packets in flight
+DrainState
+GarnetSyntheticTraffic::drain()
+{
+    return retryPkt ? DrainState::Draining : DrainState::Drained;
+}
+
 void
 GarnetSyntheticTraffic::completeRequest(PacketPtr pkt)
 {
@@ -167,6 +175,9 @@ GarnetSyntheticTraffic::tick()
         if (singleSender >= 0 && id != singleSender)
             senderEnable = false;
 
+        if (drainState() != DrainState::Running)
+            senderEnable = false;
+
         if (senderEnable)
             generatePkt();
     }
@@ -341,6 +352,8 @@ GarnetSyntheticTraffic::doRetry()
 {
     if (cachePort.sendTimingReq(retryPkt)) {
         retryPkt = NULL;
+        if (drainState() == DrainState::Draining)
+            signalDrainDone();
     }
 }
 
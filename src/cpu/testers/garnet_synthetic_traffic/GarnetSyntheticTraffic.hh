@@ -62,6 +62,8 @@ class GarnetSyntheticTraffic : public ClockedObject
 
     void init() override;
 
+    DrainState drain() override;
+
     // main simulation loop (one cycle)
     void tick();
 
@@ -55,25 +55,51 @@ Consumer::Consumer(ClockedObject *_em, Event::Priority ev_prio)
 void
 Consumer::scheduleEvent(Cycles timeDelta)
 {
-    m_wakeup_ticks.insert(em->clockEdge(timeDelta));
+    advanceWheel();
+    m_wheel.insert(em->clockEdge(timeDelta));
     scheduleNextWakeup();
 }
 
 void
 Consumer::scheduleEventAbsolute(Tick evt_time)
 {
-    m_wakeup_ticks.insert(
-        divCeil(evt_time, em->clockPeriod()) * em->clockPeriod());
+    advanceWheel();
+    m_wheel.insert(evt_time);
     scheduleNextWakeup();
 }
 
+bool
+Consumer::alreadyScheduled(Tick time)
+{
+    advanceWheel();
+    return m_wheel.contains(time);
+}
+
+// Move the wheel to the current clock edge. Returns true if the clock
+// period changed, in which case the pending wakeups moved to the edges of
+// the new clock, and a scheduled wakeup event moves with them.
+bool
+Consumer::advanceWheel()
+{
+    if (!m_wheel.advance(em->clockEdge(), em->clockPeriod()))
+        return false;
+
+    if (m_wakeup_event.scheduled()) {
+        Tick when;
+        if (m_wheel.next(when))
+            em->reschedule(m_wakeup_event, when);
+        else
+            em->deschedule(m_wakeup_event);
+    }
+    return true;
+}
+
 void
 Consumer::scheduleNextWakeup()
 {
     // look for the next tick in the future to schedule
-    auto it = m_wakeup_ticks.lower_bound(em->clockEdge());
-    if (it != m_wakeup_ticks.end()) {
-        Tick when = *it;
+    Tick when;
+    if (m_wheel.next(when)) {
         assert(when >= em->clockEdge());
         if (m_wakeup_event.scheduled() && (when < m_wakeup_event.when()))
             em->reschedule(m_wakeup_event, when, true);
@@ -85,12 +111,19 @@ Consumer::scheduleNextWakeup()
 void
 Consumer::processCurrentEvent()
 {
-    auto curr = m_wakeup_ticks.begin();
-    assert(em->clockEdge() == *curr);
+    if (advanceWheel()) {
+        // The event was scheduled on the old clock, the wakeups now wait
+        // for the edges of the new one
+        scheduleNextWakeup();
+        return;
+    }
+    assert(em->clockEdge() == curTick());
+    assert(m_wheel.currentEdge() == curTick());
 
     // remove the current tick from the wakeup list, wake up, and then schedule
     // the next wakeup
-    m_wakeup_ticks.erase(curr);
+    [[maybe_unused]] bool pending = m_wheel.takeCurrent();
+    assert(pending);
     wakeup();
     scheduleNextWakeup();
 }
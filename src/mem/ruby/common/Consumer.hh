@@ -48,8 +48,8 @@
 #define __MEM_RUBY_COMMON_CONSUMER_HH__
 
 #include <iostream>
-#include <set>
 
+#include "mem/ruby/common/WakeupWheel.hh"
 #include "sim/clocked_object.hh"
 
 namespace gem5
@@ -72,11 +72,7 @@ class Consumer
     virtual void print(std::ostream& out) const = 0;
     virtual void storeEventInfo(int info) {}
 
-    bool
-    alreadyScheduled(Tick time)
-    {
-        return m_wakeup_ticks.find(time) != m_wakeup_ticks.end();
-    }
+    bool alreadyScheduled(Tick time);
 
     ClockedObject *
     getObject()
@@ -88,10 +84,13 @@ class Consumer
     void scheduleEvent(Cycles timeDelta);
 
   private:
-    std::set<Tick> m_wakeup_ticks;
+    // Pending wakeups, at the clock edges of em
+    WakeupWheel m_wheel;
+
     EventFunctionWrapper m_wakeup_event;
     ClockedObject *em;
 
+    bool advanceWheel();
     void scheduleNextWakeup();
     void processCurrentEvent();
 };
@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2026 The gem5 contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "mem/ruby/common/WakeupWheel.hh"
+
+#include <cassert>
+
+#include "base/bitfield.hh"
+#include "base/intmath.hh"
+
+namespace gem5
+{
+
+namespace ruby
+{
+
+namespace
+{
+
+// Bit of a cycle in the wheel
+inline uint64_t
+wheelBit(uint64_t cycle)
+{
+    return 1ULL << (cycle % 64);
+}
+
+// The wheel bits of n consecutive cycles from cycle on, n < 64
+inline uint64_t
+wheelBits(uint64_t cycle, uint64_t n)
+{
+    uint64_t bits = mask(n);
+    int shift = cycle % 64;
+    return shift ? (bits << shift) | (bits >> (64 - shift)) : bits;
+}
+
+} // anonymous namespace
+
+WakeupWheel::WakeupWheel()
+    : m_wheel(0), m_base(0), m_period(0), m_offset(0)
+{ }
+
+// First cycle whose edge is at or after when
+uint64_t
+WakeupWheel::cycleAtOrAfter(Tick when) const
+{
+    return when <= m_offset ? 0 : divCeil(when - m_offset, m_period);
+}
+
+bool
+WakeupWheel::advance(Tick edge, Tick period)
+{
+    assert(period != 0);
+
+    if (period != m_period || edge % period != m_offset) {
+        // The clock changed. The pending wakeups are rebuilt from their
+        // ticks, rounded up to the edges of the new clock.
+        std::set<Tick> ticks;
+        for (uint64_t i = 0; i < WHEEL_CYCLES; i++) {
+            if (m_wheel & wheelBit(m_base + i))
+                ticks.insert(edgeOf(m_base + i));
+        }
+        ticks.insert(m_overflow_ticks.begin(), m_overflow_ticks.end());
+
+        bool changed = m_period != 0;
+        m_wheel = 0;
+        m_period = period;
+        m_offset = edge % period;
+        m_base = edge / period;
+        m_overflow_ticks.clear();
+        for (Tick when : ticks)
+            m_overflow_ticks.insert(edgeOf(cycleAtOrAfter(when)));
+        promoteOverflow();
+        return changed;
+    }
+
+    uint64_t cycle = edge / period;
+    if (cycle > m_base) {
+        uint64_t dist = cycle - m_base;
+        uint64_t passed =
+            dist >= WHEEL_CYCLES ? m_wheel : m_wheel & wheelBits(m_base, dist);
+        m_wheel &= ~passed;
+        m_base = cycle;
+        if (passed)
+            m_wheel |= wheelBit(m_base);
+        promoteOverflow();
+    }
+    return false;
+}
+
+// Take in the overflow wakeups that now fit in the wheel, those the wheel
+// has already passed at the current edge
+void
+WakeupWheel::promoteOverflow()
+{
+    Tick wheel_end = edgeOf(m_base + WHEEL_CYCLES);
+    while (!m_overflow_ticks.empty() &&
+           *m_overflow_ticks.begin() < wheel_end) {
+        uint64_t cycle = (*m_overflow_ticks.begin() - m_offset) / m_period;
+        m_overflow_ticks.erase(m_overflow_ticks.begin());
+        m_wheel |= wheelBit(cycle < m_base ? m_base : cycle);
+    }
+}
+
+void
+WakeupWheel::insert(Tick when)
+{
+    assert(m_period != 0);
+    uint64_t cycle = cycleAtOrAfter(when);
+    if (cycle < m_base)
+        return;
+    if (cycle - m_base < WHEEL_CYCLES)
+        m_wheel |= wheelBit(cycle);
+    else
+        m_overflow_ticks.insert(edgeOf(cycle));
+}
+
+bool
+WakeupWheel::contains(Tick when) const
+{
+    if (m_period == 0 || when < m_offset || (when - m_offset) % m_period)
+        return false;
+    uint64_t cycle = (when - m_offset) / m_period;
+    if (cycle >= m_base && cycle - m_base < WHEEL_CYCLES)
+        return m_wheel & wheelBit(cycle);
+    return m_overflow_ticks.find(when) != m_overflow_ticks.end();
+}
+
+bool
+WakeupWheel::next(Tick &when) const
+{
+    if (m_wheel) {
+        int shift = m_base % 64;
+        uint64_t rotated = shift ?
+            (m_wheel >> shift) | (m_wheel << (64 - shift)) : m_wheel;
+        when = edgeOf(m_base + ctz64(rotated));
+        return true;
+    }
+    if (!m_overflow_ticks.empty()) {
+        when = *m_overflow_ticks.begin();
+        return true;
+    }
+    return false;
+}
+
+bool
+WakeupWheel::takeCurrent()
+{
+    uint64_t bit = wheelBit(m_base);
+    if (!(m_wheel & bit))
+        return false;
+    m_wheel &= ~bit;
+    return true;
+}
+
+} // namespace ruby
+} // namespace gem5
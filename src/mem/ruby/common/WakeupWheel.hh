@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2026 The gem5 contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __MEM_RUBY_COMMON_WAKEUPWHEEL_HH__
+#define __MEM_RUBY_COMMON_WAKEUPWHEEL_HH__
+
+#include <cstdint>
+#include <set>
+
+#include "base/types.hh"
+
+namespace gem5
+{
+
+namespace ruby
+{
+
+// Pending wakeups of a Consumer, at the clock edges of its object.
+// The wakeups of the WHEEL_CYCLES cycles from the current one on are the
+// bits of a 64-bit wheel, indexed by cycle modulo WHEEL_CYCLES. Later
+// wakeups wait in an overflow set until the wheel reaches them. Cycle c
+// is the clock edge c * period + offset.
+class WakeupWheel
+{
+  public:
+    static const int WHEEL_CYCLES = 64;
+
+    WakeupWheel();
+
+    // Move the wheel to the clock edge edge of a clock of period period.
+    // Pending wakeups the wheel moves past are taken at edge, never
+    // dropped. Returns true if the clock changed period or phase, in which
+    // case every pending wakeup moves to the first edge of the new clock
+    // at or after it.
+    bool advance(Tick edge, Tick period);
+
+    // Record a wakeup at the first clock edge at or after when. Wakeups
+    // before the current clock edge are never taken.
+    void insert(Tick when);
+    bool contains(Tick when) const;
+
+    // Earliest pending wakeup
+    bool next(Tick &when) const;
+
+    // Take the wakeup at the current clock edge, if there is one
+    bool takeCurrent();
+
+    Tick currentEdge() const { return edgeOf(m_base); }
+
+  private:
+    uint64_t m_wheel;
+    uint64_t m_base;
+    Tick m_period;
+    Tick m_offset;
+    std::set<Tick> m_overflow_ticks;
+
+    Tick edgeOf(uint64_t cycle) const { return cycle * m_period + m_offset; }
+    uint64_t cycleAtOrAfter(Tick when) const;
+    void promoteOverflow();
+};
+
+} // namespace ruby
+} // namespace gem5
+
+#endif // __MEM_RUBY_COMMON_WAKEUPWHEEL_HH__
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2026 The gem5 contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "mem/ruby/common/WakeupWheel.hh"
+
+using namespace gem5;
+using namespace gem5::ruby;
+
+namespace
+{
+
+// Take the wakeups of the wheel in order, as a Consumer does, moving the
+// wheel from edge to edge of a clock of period period
+std::vector<Tick>
+takeAll(WakeupWheel &wheel, Tick period)
+{
+    std::vector<Tick> taken;
+    Tick when;
+    while (wheel.next(when)) {
+        EXPECT_FALSE(wheel.advance(when, period));
+        EXPECT_EQ(wheel.currentEdge(), when);
+        EXPECT_TRUE(wheel.takeCurrent());
+        EXPECT_FALSE(wheel.takeCurrent());
+        taken.push_back(when);
+    }
+    return taken;
+}
+
+} // anonymous namespace
+
+/** Wakeups are taken in order as the wheel wraps around many times. */
+TEST(WakeupWheelTest, WrapsAround)
+{
+    WakeupWheel wheel;
+    ASSERT_FALSE(wheel.advance(0, 10));
+
+    std::vector<Tick> expected;
+    for (Tick cycle = 0; cycle < 500; cycle += 7) {
+        wheel.insert(cycle * 10);
+        expected.push_back(cycle * 10);
+    }
+    ASSERT_EQ(takeAll(wheel, 10), expected);
+
+    // Wakeups inserted while the wheel moves, at every distance from
+    // the current edge
+    for (Tick cycle = 1; cycle < 200; cycle++) {
+        Tick edge = 5000 + cycle * 1000;
+        ASSERT_FALSE(wheel.advance(edge, 10));
+        wheel.insert(edge + (cycle % 70) * 10);
+        Tick when;
+        ASSERT_TRUE(wheel.next(when));
+        ASSERT_EQ(when, edge + (cycle % 70) * 10);
+        ASSERT_EQ(takeAll(wheel, 10), std::vector<Tick>{when});
+    }
+}
+
+/** Wakeups beyond the wheel move into it once it reaches them. */
+TEST(WakeupWheelTest, OverflowPromotion)
+{
+    WakeupWheel wheel;
+    wheel.advance(0, 10);
+
+    wheel.insert(5000);
+    wheel.insert(640);
+    wheel.insert(630);
+    Tick when;
+    ASSERT_TRUE(wheel.next(when));
+    ASSERT_EQ(when, 630);
+
+    wheel.advance(600, 10);
+    ASSERT_TRUE(wheel.contains(630));
+    ASSERT_TRUE(wheel.contains(640));
+    ASSERT_FALSE(wheel.contains(650));
+    ASSERT_EQ(takeAll(wheel, 10), (std::vector<Tick>{630, 640, 5000}));
+}
+
+/**
+ * A jump past pending wakeups, in the wheel or beyond it, takes them at
+ * the new edge rather than dropping them.
+ */
+TEST(WakeupWheelTest, JumpKeepsPassedWakeups)
+{
+    WakeupWheel wheel;
+    wheel.advance(0, 10);
+    wheel.insert(630);
+    wheel.insert(640);
+    wheel.insert(5000);
+
+    wheel.advance(4900, 10);
+    ASSERT_FALSE(wheel.contains(630));
+    ASSERT_FALSE(wheel.contains(640));
+    ASSERT_TRUE(wheel.contains(4900));
+    ASSERT_EQ(takeAll(wheel, 10), (std::vector<Tick>{4900, 5000}));
+}
+
+/** contains() finds the wakeups in the wheel and in the overflow. */
+TEST(WakeupWheelTest, AlreadyScheduled)
+{
+    WakeupWheel wheel;
+    wheel.advance(100, 10);
+
+    wheel.insert(120);
+    wheel.insert(2000);
+    ASSERT_TRUE(wheel.contains(120));
+    ASSERT_TRUE(wheel.contains(2000));
+    ASSERT_FALSE(wheel.contains(130));
+    ASSERT_FALSE(wheel.contains(125));
+    ASSERT_FALSE(wheel.contains(1990));
+
+    // A wakeup between edges is taken at the next edge
+    wheel.insert(141);
+    ASSERT_TRUE(wheel.contains(150));
+
+    // Wakeups before the current edge are never taken
+    wheel.insert(90);
+    ASSERT_FALSE(wheel.contains(90));
+
+    wheel.advance(120, 10);
+    ASSERT_TRUE(wheel.takeCurrent());
+    ASSERT_FALSE(wheel.contains(120));
+    ASSERT_TRUE(wheel.contains(150));
+}
+
+/**
+ * When the clock changes period or phase, the pending wakeups move to
+ * the first edge of the new clock at or after them.
+ */
+TEST(WakeupWheelTest, PeriodChange)
+{
+    WakeupWheel wheel;
+    wheel.advance(0, 10);
+    wheel.insert(30);
+    wheel.insert(50);
+    wheel.insert(1000);
+
+    // Edges at multiples of 15 from tick 15 on
+    ASSERT_TRUE(wheel.advance(15, 15));
+    ASSERT_TRUE(wheel.contains(30));
+    ASSERT_TRUE(wheel.contains(60));
+    ASSERT_TRUE(wheel.contains(1005));
+    ASSERT_FALSE(wheel.contains(50));
+    ASSERT_EQ(takeAll(wheel, 15), (std::vector<Tick>{30, 60, 1005}));
+
+    // Same period, new phase: edges at 3 modulo 15
+    wheel.insert(1050);
+    wheel.insert(4000);
+    ASSERT_TRUE(wheel.advance(1038, 15));
+    ASSERT_TRUE(wheel.contains(1053));
+    ASSERT_TRUE(wheel.contains(4008));
+    ASSERT_EQ(takeAll(wheel, 15), (std::vector<Tick>{1053, 4008}));
+}
+
+/**
+ * A wakeup the new clock only reaches after its current edge is taken at
+ * that edge rather than dropped.
+ */
+TEST(WakeupWheelTest, PeriodChangeKeepsLateWakeups)
+{
+    WakeupWheel wheel;
+    wheel.advance(0, 10);
+    wheel.insert(40);
+    wheel.insert(70);
+
+    // The next edge of the new clock is at tick 50, past the wakeup at 40
+    ASSERT_TRUE(wheel.advance(50, 25));
+    ASSERT_EQ(wheel.currentEdge(), 50);
+    ASSERT_EQ(takeAll(wheel, 25), (std::vector<Tick>{50, 75}));
+}
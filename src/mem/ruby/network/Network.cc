@@ -102,7 +102,8 @@ Network::Network(const Params &p)
 
     m_topology_ptr = new Topology(m_nodes, p.routers.size(),
                                   m_virtual_networks,
-                                  p.ext_links, p.int_links);
+                                  p.ext_links, p.int_links,
+                                  p.routing_table_cache);
 
     // Allocate to and from queues
     // Queues that are getting messages from protocol
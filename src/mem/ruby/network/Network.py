@@ -48,6 +48,11 @@ class RubyNetwork(ClockedObject):
         "highest numbered vnet in use."
     )
     control_msg_size = Param.Int(8, "")
+    routing_table_cache = Param.String(
+        "",
+        "Directory in which the routing tables computed for a topology "
+        "are cached across runs. Empty disables the cache.",
+    )
     ruby_system = Param.RubySystem("")
 
     routers = VectorParam.BasicRouter("Network routers")
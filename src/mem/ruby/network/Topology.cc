@@ -29,8 +29,27 @@
 
 #include "mem/ruby/network/Topology.hh"
 
-#include <cassert>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <thread>
+
+#include "base/bitfield.hh"
+#include "base/cprintf.hh"
+#include "base/intmath.hh"
+#include "base/logging.hh"
 #include "base/trace.hh"
 #include "debug/RubyNetwork.hh"
 #include "mem/ruby/common/NetDest.hh"
@@ -46,6 +65,31 @@ namespace ruby
 
 const int INFINITE_LATENCY = 10000; // Yes, this is a big hack
 
+namespace
+{
+
+// A routing table cache file holds ROUTE_CACHE_MAGIC, the number of
+// words of the topology key and the key, followed by the routes of each
+// vnet that has its own shortest paths, see createLinks()
+const uint64_t ROUTE_CACHE_MAGIC = 0x3130534554554f52ULL; // "ROUTES01"
+const int ROUTE_CACHE_HEADER_WORDS = 2;
+
+// FNV-1a hash of the topology key, which names the cache file
+uint64_t
+routeCacheHash(const std::vector<uint64_t> &key)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (uint64_t word : key) {
+        for (int byte = 0; byte < 8; byte++) {
+            hash ^= (word >> (8 * byte)) & 0xff;
+            hash *= 0x100000001b3ULL;
+        }
+    }
+    return hash;
+}
+
+} // anonymous namespace
+
 // Note: In this file, we use the first 2*m_nodes SwitchIDs to
 // represent the input and output endpoint links.  These really are
 // not 'switches', as they will not have a Switch object allocated for
@@ -56,9 +100,11 @@ const int INFINITE_LATENCY = 10000; // Yes, this is a big hack
 Topology::Topology(uint32_t num_nodes, uint32_t num_routers,
                    uint32_t num_vnets,
                    const std::vector<BasicExtLink *> &ext_links,
-                   const std::vector<BasicIntLink *> &int_links)
+                   const std::vector<BasicIntLink *> &int_links,
+                   const std::string &route_cache_dir)
     : m_nodes(MachineType_base_number(MachineType_NUM)),
       m_number_of_switches(num_routers), m_vnets(num_vnets),
+      m_route_cache_dir(route_cache_dir),
       m_ext_link_vector(ext_links), m_int_link_vector(int_links)
 {
     // Total nodes/controllers in network
@@ -122,32 +168,22 @@ Topology::createLinks(Network *net)
         max_switch_id = std::max(max_switch_id, src_dest.first);
         max_switch_id = std::max(max_switch_id, src_dest.second);
     }
-
-    // Initialize weight, latency, and inter switched vectors
     int num_switches = max_switch_id+1;
-    Matrix topology_weights(m_vnets,
-            std::vector<std::vector<int>>(num_switches,
-            std::vector<int>(num_switches, INFINITE_LATENCY)));
-    Matrix component_latencies(num_switches,
-            std::vector<std::vector<int>>(num_switches,
-            std::vector<int>(m_vnets, -1)));
-    Matrix component_inter_switches(num_switches,
-            std::vector<std::vector<int>>(num_switches,
-            std::vector<int>(m_vnets, 0)));
-
-    // Set identity weights to zero
-    for (int i = 0; i < topology_weights[0].size(); i++) {
-        for (int v = 0; v < m_vnets; v++) {
-            topology_weights[v][i][i] = 0;
-        }
-    }
 
-    // Fill in the topology weights and bandwidth multipliers
+    // One edge per source and destination pair of the link map, with its
+    // weight in each vnet: weights[v * num_edges + e], INFINITE_LATENCY
+    // if no link between the pair carries vnet v
+    int num_edges = m_link_map.size();
+    std::vector<SwitchID> edge_src(num_edges);
+    std::vector<SwitchID> edge_dst(num_edges);
+    std::vector<int> weights(m_vnets * num_edges, INFINITE_LATENCY);
+
+    int edge = 0;
     for (auto link_group : m_link_map) {
         std::pair<int, int> src_dest = link_group.first;
         std::vector<bool> vnet_done(m_vnets, 0);
-        int src = src_dest.first;
-        int dst = src_dest.second;
+        edge_src[edge] = src_dest.first;
+        edge_dst[edge] = src_dest.second;
 
         // Iterate over all links for this source and destination
         std::vector<LinkEntry> link_entries = link_group.second;
@@ -160,8 +196,7 @@ Topology::createLinks(Network *net)
                     fatal_if(vnet_done[v], "Two links connecting same src"
                     " and destination cannot support same vnets");
 
-                    component_latencies[src][dst][v] = link->m_latency;
-                    topology_weights[v][src][dst] = link->m_weight;
+                    weights[v * num_edges + edge] = link->m_weight;
                     vnet_done[v] = true;
                 }
             } else {
@@ -174,44 +209,119 @@ Topology::createLinks(Network *net)
                     fatal_if(vnet_done[vnet], "Two links connecting same src"
                     " and destination cannot support same vnets");
 
-                    component_latencies[src][dst][vnet] = link->m_latency;
-                    topology_weights[vnet][src][dst] = link->m_weight;
+                    weights[vnet * num_edges + edge] = link->m_weight;
                     vnet_done[vnet] = true;
                 }
             }
         }
+        edge++;
     }
 
-    // Walk topology and hookup the links
-    Matrix dist = shortest_path(topology_weights, component_latencies,
-                                component_inter_switches);
-
-    for (int i = 0; i < topology_weights[0].size(); i++) {
-        for (int j = 0; j < topology_weights[0][i].size(); j++) {
-            std::vector<NetDest> routingMap;
-            routingMap.resize(m_vnets);
-
-            // Not all sources and destinations are connected
-            // by direct links. We only construct the links
-            // which have been configured in topology.
-            bool realLink = false;
-
-            for (int v = 0; v < m_vnets; v++) {
-                int weight = topology_weights[v][i][j];
-                if (weight > 0 && weight != INFINITE_LATENCY) {
-                    realLink = true;
-                    routingMap[v] =
-                        shortest_path_to_node(i, j, topology_weights, dist, v);
-                }
+    // Vnets with the same weights have the same shortest paths, which are
+    // only computed for the first of them
+    std::vector<int> vnet_paths(m_vnets);
+    int num_paths = 0;
+    for (int v = 0; v < m_vnets; v++) {
+        vnet_paths[v] = v;
+        for (int u = 0; u < v; u++) {
+            if (std::equal(weights.begin() + v * num_edges,
+                           weights.begin() + (v + 1) * num_edges,
+                           weights.begin() + u * num_edges)) {
+                vnet_paths[v] = vnet_paths[u];
+                break;
             }
-            // Make one link for each set of vnets between
-            // a given source and destination. We do not
-            // want to create one link for each vnet.
-            if (realLink) {
-                makeLink(net, i, j, routingMap);
+        }
+        if (vnet_paths[v] == v)
+            num_paths++;
+    }
+
+    // With a routing table cache, the routes of a topology seen before are
+    // mapped from its cache file instead of being computed
+    int words = divCeil(m_nodes, 64);
+    size_t path_words = (size_t)num_edges * words;
+    std::vector<uint64_t> cache_key;
+    std::string cache_path;
+    const uint64_t *cache_map = nullptr;
+    size_t cache_bytes = 0;
+    if (!m_route_cache_dir.empty()) {
+        cache_key = route_cache_key(num_switches, edge_src, edge_dst,
+                                    weights);
+        cache_path = csprintf("%s/routes_%016x.bin", m_route_cache_dir,
+                              routeCacheHash(cache_key));
+        cache_map = map_route_cache(cache_path, cache_key,
+                                    num_paths * path_words, cache_bytes);
+    }
+
+    std::vector<std::vector<uint64_t>> routes(m_vnets);
+    std::vector<const uint64_t *> vnet_routes(m_vnets);
+    int path = 0;
+    for (int v = 0; v < m_vnets; v++) {
+        if (vnet_paths[v] != v) {
+            vnet_routes[v] = vnet_routes[vnet_paths[v]];
+        } else if (cache_map) {
+            vnet_routes[v] = cache_map + ROUTE_CACHE_HEADER_WORDS +
+                cache_key.size() + path++ * path_words;
+        } else {
+            shortest_path_routes(num_switches, edge_src, edge_dst,
+                                 &weights[v * num_edges], routes[v]);
+            vnet_routes[v] = routes[v].data();
+        }
+    }
+
+    if (!cache_path.empty() && !cache_map) {
+        write_route_cache(cache_path, cache_key, routes, vnet_paths);
+    }
+
+    // Machine of each node, nodes being numbered in machine order
+    std::vector<MachineID> machines;
+    machines.reserve(m_nodes);
+    for (int m = 0; m < MachineType_NUM; m++) {
+        for (NodeID i = 0; i < MachineType_base_count((MachineType)m); i++) {
+            machines.push_back({(MachineType)m, i});
+        }
+    }
+    assert(machines.size() == m_nodes);
+
+    // Walk topology and hookup the links, in the (source, destination)
+    // order of the link map
+    edge = 0;
+    for (auto link_group : m_link_map) {
+        std::vector<NetDest> routingMap;
+        routingMap.resize(m_vnets);
+
+        // Not all sources and destinations are connected
+        // by direct links. We only construct the links
+        // which have been configured in topology.
+        bool realLink = false;
+
+        for (int v = 0; v < m_vnets; v++) {
+            int weight = weights[v * num_edges + edge];
+            if (weight > 0 && weight != INFINITE_LATENCY) {
+                realLink = true;
+                const uint64_t *edge_routes =
+                    vnet_routes[v] + (size_t)edge * words;
+                for (int w = 0; w < words; w++) {
+                    for (uint64_t bits = edge_routes[w]; bits;
+                         bits &= bits - 1) {
+                        routingMap[v].add(machines[w * 64 + ctz64(bits)]);
+                    }
+                }
+                DPRINTF(RubyNetwork, "Shortest path from switch %d via %d "
+                        "in vnet %d: %s\n", edge_src[edge], edge_dst[edge],
+                        v, routingMap[v]);
             }
         }
+        // Make one link for each set of vnets between
+        // a given source and destination. We do not
+        // want to create one link for each vnet.
+        if (realLink) {
+            makeLink(net, edge_src[edge], edge_dst[edge], routingMap);
+        }
+        edge++;
     }
+
+    if (cache_map)
+        munmap((void *)cache_map, cache_bytes);
 }
 
 void
@@ -330,120 +440,196 @@ Topology::makeLink(Network *net, SwitchID src, SwitchID dest,
     }
 }
 
-// The following all-pairs shortest path algorithm is based on the
-// discussion from Cormen et al., Chapter 26.1.
+// Find the edges on the shortest paths to each node. Bit d % 64 of
+// routes[e * words + d / 64] is set when edge e is on a shortest path to
+// the output switch of node d, i.e. when the edge weight plus the distance
+// from its destination to the node is the distance from its source.
+// Distances to each node come from Dijkstra's algorithm on the reversed
+// graph, and are capped at INFINITE_LATENCY like unreachable switches.
+// Nodes are split across host threads in blocks of 64, so that each
+// thread owns whole words of routes.
 void
-Topology::extend_shortest_path(Matrix &current_dist, Matrix &latencies,
-    Matrix &inter_switches)
+Topology::shortest_path_routes(int num_switches,
+                               const std::vector<SwitchID> &edge_src,
+                               const std::vector<SwitchID> &edge_dst,
+                               const int *weights,
+                               std::vector<uint64_t> &routes)
 {
-    int nodes = current_dist[0].size();
-
-    // We find the shortest path for each vnet for a given pair of
-    // source and destinations. This is done simply by traversing via
-    // all other nodes and finding the minimum distance.
-    for (int v = 0; v < m_vnets; v++) {
-        // There is a different topology for each vnet. Here we try to
-        // build a topology by finding the minimum number of intermediate
-        // switches needed to reach the destination
-        bool change = true;
-        while (change) {
-            change = false;
-            for (int i = 0; i < nodes; i++) {
-                for (int j = 0; j < nodes; j++) {
-                    // We follow an iterative process to build the shortest
-                    // path tree:
-                    // 1. Start from the direct connection (if there is one,
-                    // otherwise assume a hypothetical infinite weight link).
-                    // 2. Then we iterate through all other nodes considering
-                    // new potential intermediate switches. If we find any
-                    // lesser weight combination, we set(update) that as the
-                    // new weight between the source and destination.
-                    // 3. Repeat for all pairs of nodes.
-                    // 4. Go to step 1 if there was any new update done in
-                    // Step 2.
-                    int minimum = current_dist[v][i][j];
-                    int previous_minimum = minimum;
-                    int intermediate_switch = -1;
-                    for (int k = 0; k < nodes; k++) {
-                        minimum = std::min(minimum,
-                            current_dist[v][i][k] + current_dist[v][k][j]);
-                        if (previous_minimum != minimum) {
-                            intermediate_switch = k;
-                            inter_switches[i][j][v] =
-                                inter_switches[i][k][v] +
-                                inter_switches[k][j][v] + 1;
+    int num_edges = edge_src.size();
+    int words = divCeil(m_nodes, 64);
+    routes.assign((size_t)num_edges * words, 0);
+
+    // Edges into each switch: in_edges[in_offsets[s], in_offsets[s + 1])
+    std::vector<int> in_offsets(num_switches + 1, 0);
+    std::vector<int> in_edges(num_edges);
+    for (int e = 0; e < num_edges; e++)
+        in_offsets[edge_dst[e] + 1]++;
+    for (int s = 0; s < num_switches; s++)
+        in_offsets[s + 1] += in_offsets[s];
+    std::vector<int> next_in(in_offsets.begin(), in_offsets.end() - 1);
+    for (int e = 0; e < num_edges; e++)
+        in_edges[next_in[edge_dst[e]]++] = e;
+
+    std::atomic<int> next_block(0);
+    auto find_routes = [&]() {
+        typedef std::pair<int, int> DistSwitch;
+        std::vector<int> dist(num_switches);
+        std::priority_queue<DistSwitch, std::vector<DistSwitch>,
+                            std::greater<DistSwitch>> queue;
+
+        for (int block = next_block++; block < words; block = next_block++) {
+            int last_node = std::min<int>(m_nodes, (block + 1) * 64);
+            for (int node = block * 64; node < last_node; node++) {
+                // Output switch of the node
+                int dest = node + m_nodes;
+                if (dest >= num_switches)
+                    continue;
+
+                std::fill(dist.begin(), dist.end(), INFINITE_LATENCY);
+                dist[dest] = 0;
+                queue.push(DistSwitch(0, dest));
+                while (!queue.empty()) {
+                    DistSwitch top = queue.top();
+                    queue.pop();
+                    if (top.first > dist[top.second])
+                        continue;
+                    for (int i = in_offsets[top.second];
+                         i < in_offsets[top.second + 1]; i++) {
+                        int e = in_edges[i];
+                        int d = top.first + weights[e];
+                        if (d < dist[edge_src[e]]) {
+                            dist[edge_src[e]] = d;
+                            queue.push(DistSwitch(d, edge_src[e]));
                         }
-                        previous_minimum = minimum;
-                    }
-                    if (current_dist[v][i][j] != minimum) {
-                        change = true;
-                        current_dist[v][i][j] = minimum;
-                        assert(intermediate_switch >= 0);
-                        assert(intermediate_switch < latencies[i].size());
-                        latencies[i][j][v] =
-                            latencies[i][intermediate_switch][v] +
-                            latencies[intermediate_switch][j][v];
                     }
                 }
+
+                uint64_t bit = (uint64_t)1 << (node % 64);
+                for (int e = 0; e < num_edges; e++) {
+                    if (weights[e] + dist[edge_dst[e]] == dist[edge_src[e]])
+                        routes[(size_t)e * words + block] |= bit;
+                }
             }
         }
-    }
+    };
+
+    int num_threads = std::max(1, std::min<int>(words,
+        std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    for (int t = 1; t < num_threads; t++)
+        threads.emplace_back(find_routes);
+    find_routes();
+    for (auto &thread : threads)
+        thread.join();
 }
 
-Matrix
-Topology::shortest_path(const Matrix &weights, Matrix &latencies,
-                        Matrix &inter_switches)
+// Everything the routes depend on: the machine counts, the vnets, and the
+// edges of the link graph with their weights
+std::vector<uint64_t>
+Topology::route_cache_key(int num_switches,
+                          const std::vector<SwitchID> &edge_src,
+                          const std::vector<SwitchID> &edge_dst,
+                          const std::vector<int> &weights)
 {
-    Matrix dist = weights;
-    extend_shortest_path(dist, latencies, inter_switches);
-    return dist;
+    std::vector<uint64_t> key;
+    key.push_back(m_nodes);
+    key.push_back(m_vnets);
+    key.push_back(num_switches);
+    key.push_back(edge_src.size());
+    for (int m = 0; m < MachineType_NUM; m++)
+        key.push_back(MachineType_base_count((MachineType)m));
+    for (int e = 0; e < edge_src.size(); e++)
+        key.push_back(((uint64_t)edge_src[e] << 32) | edge_dst[e]);
+    for (int weight : weights)
+        key.push_back((uint32_t)weight);
+    return key;
 }
 
-bool
-Topology::link_is_shortest_path_to_node(SwitchID src, SwitchID next,
-                                        SwitchID final, const Matrix &weights,
-                                        const Matrix &dist, int vnet)
+// Map the cache file at path, if it holds the routes of the topology with
+// the given key. Returns the start of the mapping, or nullptr.
+const uint64_t *
+Topology::map_route_cache(const std::string &path,
+                          const std::vector<uint64_t> &key,
+                          size_t route_words, size_t &map_bytes)
 {
-    return weights[vnet][src][next] + dist[vnet][next][final] ==
-        dist[vnet][src][final];
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+
+    map_bytes = (ROUTE_CACHE_HEADER_WORDS + key.size() + route_words) *
+        sizeof(uint64_t);
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        warn("Ignoring routing table cache %s, it could not be read: %s.",
+             path, std::strerror(errno));
+        close(fd);
+        return nullptr;
+    }
+    if (file_stat.st_size != map_bytes) {
+        warn("Ignoring routing table cache %s, it does not have the size "
+             "of the routes of this topology.", path);
+        close(fd);
+        return nullptr;
+    }
+
+    void *map = mmap(nullptr, map_bytes, PROT_READ, MAP_SHARED, fd, 0);
+    int map_errno = errno;
+    close(fd);
+    if (map == MAP_FAILED) {
+        warn("Ignoring routing table cache %s, it could not be mapped: %s.",
+             path, std::strerror(map_errno));
+        return nullptr;
+    }
+
+    const uint64_t *words = (const uint64_t *)map;
+    if (words[0] != ROUTE_CACHE_MAGIC || words[1] != key.size() ||
+        !std::equal(key.begin(), key.end(),
+                    words + ROUTE_CACHE_HEADER_WORDS)) {
+        warn("Ignoring routing table cache %s, it was built for another "
+             "topology.", path);
+        munmap(map, map_bytes);
+        return nullptr;
+    }
+
+    DPRINTF(RubyNetwork, "Mapped the routes from %s\n", path);
+    return words;
 }
 
-NetDest
-Topology::shortest_path_to_node(SwitchID src, SwitchID next,
-                                const Matrix &weights, const Matrix &dist,
-                                int vnet)
+void
+Topology::write_route_cache(const std::string &path,
+                            const std::vector<uint64_t> &key,
+                            const std::vector<std::vector<uint64_t>> &routes,
+                            const std::vector<int> &vnet_paths)
 {
-    NetDest result;
-    int d = 0;
-    int machines;
-    int max_machines;
-
-    machines = MachineType_NUM;
-    max_machines = MachineType_base_number(MachineType_NUM);
+    // The first run with a new cache directory creates it
+    std::error_code ec;
+    std::filesystem::create_directories(m_route_cache_dir, ec);
+    if (ec) {
+        warn("Could not create the routing table cache directory %s: %s.",
+             m_route_cache_dir, ec.message());
+        return;
+    }
 
-    for (int m = 0; m < machines; m++) {
-        for (NodeID i = 0; i < MachineType_base_count((MachineType)m); i++) {
-            // we use "d+max_machines" below since the "destination"
-            // switches for the machines are numbered
-            // [MachineType_base_number(MachineType_NUM)...
-            //  2*MachineType_base_number(MachineType_NUM)-1] for the
-            // component network
-            if (link_is_shortest_path_to_node(src, next, d + max_machines,
-                    weights, dist, vnet)) {
-                MachineID mach = {(MachineType)m, i};
-                result.add(mach);
-            }
-            d++;
+    // Concurrent runs write their own temporary file and rename it, so a
+    // cache file is never seen partially written
+    std::string tmp_path = csprintf("%s.%d", path, getpid());
+    std::ofstream file(tmp_path, std::ios::binary);
+    uint64_t header[ROUTE_CACHE_HEADER_WORDS] = {ROUTE_CACHE_MAGIC,
+                                                 key.size()};
+    file.write((const char *)header, sizeof(header));
+    file.write((const char *)key.data(), key.size() * sizeof(uint64_t));
+    for (int v = 0; v < m_vnets; v++) {
+        if (vnet_paths[v] == v) {
+            file.write((const char *)routes[v].data(),
+                       routes[v].size() * sizeof(uint64_t));
         }
     }
+    file.close();
 
-    DPRINTF(RubyNetwork, "Returning shortest path\n"
-            "(src-(2*max_machines)): %d, (next-(2*max_machines)): %d, "
-            "src: %d, next: %d, vnet:%d result: %s\n",
-            (src-(2*max_machines)), (next-(2*max_machines)),
-            src, next, vnet, result);
-
-    return result;
+    if (!file || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        warn("Could not write the routing table cache %s.", path);
+        std::remove(tmp_path.c_str());
+    }
 }
 
 } // namespace ruby
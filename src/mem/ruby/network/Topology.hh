@@ -42,6 +42,7 @@
 #define __MEM_RUBY_NETWORK_TOPOLOGY_HH__
 
 #include <iostream>
+#include <string>
 #include <vector>
 
 #include "mem/ruby/common/TypeDefines.hh"
@@ -57,14 +58,6 @@ namespace ruby
 class NetDest;
 class Network;
 
-/*
- * We use a three-dimensional vector matrix for calculating
- * the shortest paths for each pair of source and destination
- * and for each type of virtual network. The three dimensions
- * represent the source ID, destination ID, and vnet number.
- */
-typedef std::vector<std::vector<std::vector<int>>> Matrix;
-
 struct LinkEntry
 {
     BasicLink *link;
@@ -80,7 +73,8 @@ class Topology
   public:
     Topology(uint32_t num_nodes, uint32_t num_routers, uint32_t num_vnets,
              const std::vector<BasicExtLink *> &ext_links,
-             const std::vector<BasicIntLink *> &int_links);
+             const std::vector<BasicIntLink *> &int_links,
+             const std::string &route_cache_dir = "");
 
     uint32_t numSwitches() const { return m_number_of_switches; }
     void createLinks(Network *net);
@@ -93,25 +87,33 @@ class Topology
     void makeLink(Network *net, SwitchID src, SwitchID dest,
                   std::vector<NetDest>& routing_table_entry);
 
-    // Helper functions based on chapter 29 of Cormen et al.
-    void extend_shortest_path(Matrix &current_dist, Matrix &latencies,
-                              Matrix &inter_switches);
-
-    Matrix shortest_path(const Matrix &weights,
-            Matrix &latencies, Matrix &inter_switches);
-
-    bool link_is_shortest_path_to_node(SwitchID src, SwitchID next,
-            SwitchID final, const Matrix &weights, const Matrix &dist,
-            int vnet);
-
-    NetDest shortest_path_to_node(SwitchID src, SwitchID next,
-                                  const Matrix &weights, const Matrix &dist,
-                                  int vnet);
+    // Edges on the shortest paths to each node, as bitsets of nodes
+    void shortest_path_routes(int num_switches,
+                              const std::vector<SwitchID> &edge_src,
+                              const std::vector<SwitchID> &edge_dst,
+                              const int *weights,
+                              std::vector<uint64_t> &routes);
+
+    // On-disk cache of the routes, see createLinks()
+    std::vector<uint64_t> route_cache_key(
+        int num_switches, const std::vector<SwitchID> &edge_src,
+        const std::vector<SwitchID> &edge_dst,
+        const std::vector<int> &weights);
+    const uint64_t *map_route_cache(const std::string &path,
+                                    const std::vector<uint64_t> &key,
+                                    size_t route_words, size_t &map_bytes);
+    void write_route_cache(const std::string &path,
+                           const std::vector<uint64_t> &key,
+                           const std::vector<std::vector<uint64_t>> &routes,
+                           const std::vector<int> &vnet_paths);
 
     const uint32_t m_nodes;
     const uint32_t m_number_of_switches;
     int m_vnets;
 
+    // Directory of the routing table cache, empty when disabled
+    std::string m_route_cache_dir;
+
     std::vector<BasicExtLink*> m_ext_link_vector;
     std::vector<BasicIntLink*> m_int_link_vector;
 
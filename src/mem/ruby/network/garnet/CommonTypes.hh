@@ -31,7 +31,17 @@
 #ifndef __MEM_RUBY_NETWORK_GARNET_0_COMMONTYPES_HH__
 #define __MEM_RUBY_NETWORK_GARNET_0_COMMONTYPES_HH__
 
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+#include "base/bitfield.hh"
+#include "enums/GarnetVcClass.hh"
 #include "mem/ruby/common/NetDest.hh"
+#include "mem/ruby/network/garnet/FlitPool.hh"
 
 namespace gem5
 {
@@ -60,23 +70,238 @@ enum channel_type {R1xp = 0, R2xp = 1, R1xn = 2, R2xn = 3,
                    R1zp = 8, R2zp = 9, R1zn = 10, R2zn = 11,
                    NUM_CHANNEL_TYPES_};
 
+// Port directions are interned to small integer IDs while the topology is
+// built, see GarnetNetwork::internPortDirection(). The direction names are
+// only kept for configuration and debug output. The names used by the
+// built-in routing algorithms have fixed IDs; any other name found in the
+// topology gets the next free ID.
+typedef int PortDirectionId;
+enum port_direction_type {UNKNOWN_DIRN_ = -1,
+                          LOCAL_DIRN_ = 0, NORTH_DIRN_, SOUTH_DIRN_,
+                          EAST_DIRN_, WEST_DIRN_, LEFT_DIRN_, RIGHT_DIRN_,
+                          FRONT_DIRN_, BACK_DIRN_, UP_DIRN_, DOWN_DIRN_,
+                          NUM_BUILTIN_DIRN_};
+
+// Route header of a packet, built once by the source NI and shared
+// (read-only) by all the flits of the packet.
+// A multicast packet has no single destination (dest_ni and dest_router
+// are -1) and is routed on its destination set net_dest. The routers
+// split it into branches, each with its own route owning the destination
+// set of the branch in branch_dest. A branch left with one destination
+// is routed as a unicast packet.
+// Shared routes live in the FlitPool of the region that built them:
+// allocate them with new (pool) RouteInfo and hand them to a RouteInfoPtr.
 struct RouteInfo
 {
     RouteInfo()
-        : vnet(0), src_ni(0), src_router(0), dest_ni(0), dest_router(0),
-          hops_traversed(0)
+        : vnet(0), net_dest(nullptr), src_ni(0), src_router(0), dest_ni(0),
+          dest_router(0), multicast(false), m_refs(0), m_shared(false)
     {}
 
+    // Routes are not copied, so that no branch destinations are copied
+    // along; copyHeader() takes all the other fields
+    RouteInfo(const RouteInfo &route) = delete;
+    RouteInfo &operator=(const RouteInfo &route) = delete;
+
+    void
+    copyHeader(const RouteInfo &route)
+    {
+        vnet = route.vnet;
+        net_dest = route.net_dest;
+        src_ni = route.src_ni;
+        src_router = route.src_router;
+        dest_ni = route.dest_ni;
+        dest_router = route.dest_router;
+        multicast = route.multicast;
+    }
+
+    static void *
+    operator new(std::size_t size, FlitPool &pool)
+    {
+        return pool.allocate(size);
+    }
+    static void operator delete(void *ptr) { FlitPool::release(ptr); }
+    static void
+    operator delete(void *ptr, FlitPool &pool)
+    {
+        FlitPool::release(ptr);
+    }
+
     // destination format for table-based routing
+    // net_dest points to the destination of the packet's message,
+    // which the flits keep alive through their MsgPtr, or to branch_dest
     int vnet;
-    NetDest net_dest;
+    const NetDest *net_dest;
 
     // src and dest format for topology-specific routing
     int src_ni;
     int src_router;
     int dest_ni;
     int dest_router;
-    int hops_traversed;
+
+    bool multicast;
+    std::optional<NetDest> branch_dest;
+
+  private:
+    friend class RouteInfoPtr;
+
+    // The flits and VCs referencing the route. The count only needs
+    // atomic updates when the threads of several regions share the pool.
+    mutable std::atomic<uint32_t> m_refs;
+    bool m_shared;
+
+    void
+    addRef() const
+    {
+        if (m_shared) {
+            m_refs.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            m_refs.store(m_refs.load(std::memory_order_relaxed) + 1,
+                         std::memory_order_relaxed);
+        }
+    }
+
+    // Returns whether this was the last reference
+    bool
+    release() const
+    {
+        if (m_shared)
+            return m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        uint32_t refs = m_refs.load(std::memory_order_relaxed) - 1;
+        m_refs.store(refs, std::memory_order_relaxed);
+        return refs == 0;
+    }
+};
+
+// Counted reference to a (read-only) RouteInfo taken from a FlitPool. The
+// route goes back to its pool with the last reference.
+class RouteInfoPtr
+{
+  public:
+    RouteInfoPtr() : m_route(nullptr) {}
+    RouteInfoPtr(std::nullptr_t) : m_route(nullptr) {}
+
+    // Takes the first reference to a route allocated from a FlitPool
+    explicit RouteInfoPtr(RouteInfo *route) : m_route(route)
+    {
+        route->m_shared = FlitPool::owner(route)->isShared();
+        route->addRef();
+    }
+
+    RouteInfoPtr(const RouteInfoPtr &other) : m_route(other.m_route)
+    {
+        if (m_route)
+            m_route->addRef();
+    }
+
+    RouteInfoPtr(RouteInfoPtr &&other) : m_route(other.m_route)
+    {
+        other.m_route = nullptr;
+    }
+
+    ~RouteInfoPtr()
+    {
+        if (m_route && m_route->release())
+            delete m_route;
+    }
+
+    RouteInfoPtr &
+    operator=(RouteInfoPtr other)
+    {
+        std::swap(m_route, other.m_route);
+        return *this;
+    }
+
+    const RouteInfo &operator*() const { return *m_route; }
+    const RouteInfo *operator->() const { return m_route; }
+    const RouteInfo *get() const { return m_route; }
+    explicit operator bool() const { return m_route != nullptr; }
+
+  private:
+    const RouteInfo *m_route;
+};
+
+// VC classes split the VCs of each vnet, see the vc_classes parameter of
+// GarnetNetwork. Routing functions restrict the output VCs a packet may
+// take to a mask of classes, with bit c set for GarnetVcClass c.
+typedef uint32_t VcClassMask;
+
+inline VcClassMask
+vcClassBit(GarnetVcClass vc_class)
+{
+    return (VcClassMask)1 << (int)vc_class;
+}
+
+const VcClassMask ALL_VC_CLASSES_ =
+    ((VcClassMask)1 << (int)GarnetVcClass::Num_GarnetVcClass) - 1;
+
+// Candidate (outport, VC classes) pairs of an adaptive routing function:
+// the packet may leave through any candidate outport on an output VC of
+// one of the candidate's classes. The 3D torus routing uses the adaptive
+// class for its R1 channels and the escape class for its R2 channels.
+// Each candidate is a (outport << 8 | vc_classes) key in a fixed sorted
+// array, so the set needs no allocation, and the candidates are visited
+// in ascending (outport, vc_classes) order.
+class OutportCandidates
+{
+  public:
+    static constexpr int MAX_OUTPORTS = 256;
+    static constexpr int MAX_CANDIDATES = 8;
+
+    OutportCandidates() : m_size(0) {}
+
+    void
+    add(int outport, VcClassMask vc_classes)
+    {
+        assert(outport >= 0 && outport < MAX_OUTPORTS);
+        assert(vc_classes != 0 && vc_classes <= ALL_VC_CLASSES_);
+        uint16_t key = (outport << 8) | vc_classes;
+        int idx = 0;
+        while (idx < m_size && m_keys[idx] < key)
+            idx++;
+        if (idx < m_size && m_keys[idx] == key)
+            return;
+        assert(m_size < MAX_CANDIDATES);
+        for (int i = m_size; i > idx; i--)
+            m_keys[i] = m_keys[i - 1];
+        m_keys[idx] = key;
+        m_size++;
+    }
+
+    void clear()                { m_size = 0; }
+    bool empty() const          { return m_size == 0; }
+    int size() const            { return m_size; }
+
+    // Outport and VC classes of the idx-th candidate (0 <= idx < size())
+    int get_outport(int idx) const  { return key(idx) >> 8; }
+    VcClassMask
+    get_vc_classes(int idx) const
+    {
+        return key(idx) & 0xff;
+    }
+
+  private:
+    uint16_t
+    key(int idx) const
+    {
+        assert(idx >= 0 && idx < m_size);
+        return m_keys[idx];
+    }
+
+    uint16_t m_keys[MAX_CANDIDATES];
+    uint8_t m_size;
+};
+
+// A branch of a multicast packet at a router: the outport and VC classes
+// its copy of the packet leaves through, the output VC once allocated,
+// and its route (null if the packet has a single branch and keeps its
+// own route).
+struct MulticastBranch
+{
+    int outport;
+    VcClassMask vc_classes;
+    int outvc;
+    RouteInfoPtr route;
 };
 
 #define INFINITE_ 10000
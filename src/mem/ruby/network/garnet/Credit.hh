@@ -32,11 +32,10 @@
 #define __MEM_RUBY_NETWORK_GARNET_0_CREDIT_HH__
 
 #include <cassert>
+#include <cstdint>
 #include <iostream>
 
 #include "base/types.hh"
-#include "mem/ruby/network/garnet/CommonTypes.hh"
-#include "mem/ruby/network/garnet/flit.hh"
 
 namespace gem5
 {
@@ -48,28 +47,65 @@ namespace garnet
 {
 
 // Credit Signal for buffers inside VC
-// Carries m_vc (inherits from flit.hh)
-// and m_is_free_signal (whether VC is free or not)
+// A credit word holds the credits a router or NI sends back over one
+// credit link in one cycle: bit v of m_vcs gives one buffer slot of VC v
+// back to the upstream router at time m_time, and bit v of m_free_vcs
+// also frees the VC (the is_free_signal of the VC). At most one flit
+// leaves a VC per cycle, so a bit per VC is enough. Credit words are
+// plain values that move through CreditBuffers and CreditLinks,
+// separately from the flits.
 
-class Credit : public flit
+class Credit
 {
   public:
-    Credit() {};
-    Credit(int vc, bool is_free_signal, Tick curTime);
+    static const int MAX_VCS = 64;
 
-    // Functions used by SerDes
-    flit* serialize(int ser_id, int parts, uint32_t bWidth);
-    flit* deserialize(int des_id, int num_flits, uint32_t bWidth);
-    void print(std::ostream& out) const;
+    Credit() : m_vcs(0), m_free_vcs(0), m_time(0) {}
+    explicit Credit(Tick curTime) : m_vcs(0), m_free_vcs(0), m_time(curTime)
+    {}
+
+    uint64_t get_vcs() const { return m_vcs; }
+    uint64_t get_free_vcs() const { return m_free_vcs; }
+    Tick get_time() const { return m_time; }
+    void set_time(Tick time) { m_time = time; }
+
+    // Credit one slot of VC vc, and free the VC if is_free_signal
+    void
+    add(int vc, bool is_free_signal)
+    {
+        assert(vc >= 0 && vc < MAX_VCS);
+        uint64_t bit = (uint64_t)1 << vc;
+        assert(!(m_vcs & bit));
+        m_vcs |= bit;
+        if (is_free_signal)
+            m_free_vcs |= bit;
+    }
 
-    ~Credit() {};
+    // Add the credits of another word of the same cycle
+    void
+    merge(const Credit &credit)
+    {
+        assert(credit.m_time == m_time && !(m_vcs & credit.m_vcs));
+        m_vcs |= credit.m_vcs;
+        m_free_vcs |= credit.m_free_vcs;
+    }
 
-    bool is_free_signal() { return m_is_free_signal; }
+    void print(std::ostream& out) const;
 
   private:
-    bool m_is_free_signal;
+    uint64_t m_vcs;
+    uint64_t m_free_vcs;
+    Tick m_time;
 };
 
+inline std::ostream&
+operator<<(std::ostream& out, const Credit& obj)
+{
+    obj.print(out);
+    out << std::flush;
+    return out;
+}
+
 } // namespace garnet
 } // namespace ruby
 } // namespace gem5
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2026 The gem5 contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mem/ruby/network/garnet/CreditBuffer.hh"
+
+namespace gem5
+{
+
+namespace ruby
+{
+
+namespace garnet
+{
+
+namespace
+{
+
+// Ring size of a credit buffer before it first grows
+const int INITIAL_RING_SIZE = 4;
+
+} // anonymous namespace
+
+CreditBuffer::CreditBuffer()
+    : m_ring(INITIAL_RING_SIZE), m_mask(INITIAL_RING_SIZE - 1), m_head(0),
+      m_tail(0)
+{
+}
+
+// The word of cycle curTime that can take credits for the VCs vcs,
+// appended if the last word is of an earlier cycle or already credits one
+// of them
+Credit &
+CreditBuffer::tailWord(Tick curTime, uint64_t vcs)
+{
+    if (!isEmpty()) {
+        Credit &last = m_ring[(m_tail - 1) & m_mask];
+        assert(last.get_time() <= curTime);
+        if (last.get_time() == curTime && !(last.get_vcs() & vcs))
+            return last;
+    }
+
+    if (m_tail - m_head == m_ring.size()) {
+        std::vector<Credit> ring(2 * m_ring.size());
+        for (uint32_t i = m_head; i != m_tail; i++)
+            ring[i - m_head] = m_ring[i & m_mask];
+        m_tail -= m_head;
+        m_head = 0;
+        m_ring.swap(ring);
+        m_mask = m_ring.size() - 1;
+    }
+
+    Credit &word = m_ring[m_tail++ & m_mask];
+    word = Credit(curTime);
+    return word;
+}
+
+void
+CreditBuffer::print(std::ostream& out) const
+{
+    out << "[CreditBuffer: " << getSize() << "] " << std::endl;
+}
+
+} // namespace garnet
+} // namespace ruby
+} // namespace gem5
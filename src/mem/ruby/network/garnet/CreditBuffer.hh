@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2026 The gem5 contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __MEM_RUBY_NETWORK_GARNET_0_CREDITBUFFER_HH__
+#define __MEM_RUBY_NETWORK_GARNET_0_CREDITBUFFER_HH__
+
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "base/types.hh"
+#include "mem/ruby/network/garnet/Credit.hh"
+
+namespace gem5
+{
+
+namespace ruby
+{
+
+namespace garnet
+{
+
+// FIFO of the credit words waiting for, or crossing, a CreditLink, in a
+// ring of power-of-two size. Words are inserted in time order, and a
+// credit for a cycle that already has a word is ORed into it, so a cycle
+// usually carries one word. A credit for a VC the word already credits
+// starts a second word of the same cycle. The ring holds the few cycles
+// of credits in flight on a link and only doubles if more back up.
+class CreditBuffer
+{
+  public:
+    CreditBuffer();
+
+    bool
+    isReady(Tick curTime) const
+    {
+        return !isEmpty() && peekTopCredit().get_time() <= curTime;
+    }
+
+    bool isEmpty() const { return m_head == m_tail; }
+    int getSize() const { return m_tail - m_head; }
+    void print(std::ostream& out) const;
+
+    Credit
+    getTopCredit()
+    {
+        assert(!isEmpty());
+        return m_ring[m_head++ & m_mask];
+    }
+
+    const Credit &
+    peekTopCredit() const
+    {
+        assert(!isEmpty());
+        return m_ring[m_head & m_mask];
+    }
+
+    // Credit one slot of VC vc at time curTime
+    void
+    insert(int vc, bool is_free_signal, Tick curTime)
+    {
+        tailWord(curTime, (uint64_t)1 << vc).add(vc, is_free_signal);
+    }
+
+    // Add a whole word of credits at its time
+    void
+    insert(const Credit &credit)
+    {
+        tailWord(credit.get_time(), credit.get_vcs()).merge(credit);
+    }
+
+  private:
+    Credit &tailWord(Tick curTime, uint64_t vcs);
+
+    // Words are at m_ring[i & m_mask] for i in [m_head, m_tail)
+    std::vector<Credit> m_ring;
+    uint32_t m_mask;
+    uint32_t m_head;
+    uint32_t m_tail;
+};
+
+inline std::ostream&
+operator<<(std::ostream& out, const CreditBuffer& obj)
+{
+    obj.print(out);
+    out << std::flush;
+    return out;
+}
+
+} // namespace garnet
+} // namespace ruby
+} // namespace gem5
+
+#endif // __MEM_RUBY_NETWORK_GARNET_0_CREDITBUFFER_HH__
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2026 The gem5 contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "mem/ruby/network/garnet/CreditLink.hh"
+
+#include "base/bitfield.hh"
+#include "base/trace.hh"
+#include "debug/RubyNetwork.hh"
+
+namespace gem5
+{
+
+namespace ruby
+{
+
+namespace garnet
+{
+
+void
+CreditLink::setSourceQueue(CreditBuffer *src_queue,
+                           ClockedObject *srcClockObject)
+{
+    credit_srcQueue = src_queue;
+    NetworkLink::setSourceQueue(nullptr, srcClockObject);
+}
+
+void
+CreditLink::wakeup()
+{
+    DPRINTF(RubyNetwork, "Woke up to transfer credits from %s\n",
+        getSourceObject()->name());
+    assert(credit_srcQueue != nullptr);
+    assert(curTick() == clockEdge());
+
+    Tick arrival = clockEdge(getLatency());
+    bool sent = false;
+    while (credit_srcQueue->isReady(curTick())) {
+        Credit t_credit = credit_srcQueue->getTopCredit();
+        DPRINTF(RubyNetwork, "Transmission will finish at %ld :%s\n",
+                arrival, t_credit);
+        t_credit.set_time(arrival);
+        if (m_cross_region) {
+            std::lock_guard<std::mutex> lock(m_region_mutex);
+            creditBuffer.insert(t_credit);
+        } else {
+            creditBuffer.insert(t_credit);
+        }
+        for (uint64_t vcs = t_credit.get_vcs(); vcs; vcs &= vcs - 1)
+            m_vc_load[ctz64(vcs)]++;
+        sent = true;
+    }
+
+    if (sent) {
+        wakeupConsumer(arrival);
+        m_link_utilized++;
+    }
+
+    if (!credit_srcQueue->isEmpty()) {
+        scheduleWakeup(Cycles(1));
+    }
+}
+
+} // namespace garnet
+} // namespace ruby
+} // namespace gem5
@@ -31,6 +31,11 @@
 #ifndef __MEM_RUBY_NETWORK_GARNET_0_CREDITLINK_HH__
 #define __MEM_RUBY_NETWORK_GARNET_0_CREDITLINK_HH__
 
+#include <mutex>
+
+#include "base/logging.hh"
+#include "mem/ruby/network/garnet/Credit.hh"
+#include "mem/ruby/network/garnet/CreditBuffer.hh"
 #include "mem/ruby/network/garnet/NetworkLink.hh"
 #include "params/CreditLink.hh"
 
@@ -43,11 +48,63 @@ namespace ruby
 namespace garnet
 {
 
+// Credit links carry credit words from a CreditBuffer of their source to
+// the CreditBuffer read by their consumer, instead of flits. The words
+// ready in a cycle cross the link together, merged where their VCs do not
+// overlap.
 class CreditLink : public NetworkLink
 {
   public:
     typedef CreditLinkParams Params;
-    CreditLink(const Params &p) : NetworkLink(p) {}
+    CreditLink(const Params &p)
+        : NetworkLink(p), creditBuffer(), credit_srcQueue(nullptr)
+    {}
+
+    using NetworkLink::setSourceQueue;
+    void setSourceQueue(CreditBuffer *src_queue,
+                        ClockedObject *srcClockObject);
+    CreditBuffer *getCreditBuffer() { return &creditBuffer; }
+    void wakeup() override;
+
+    void
+    setVcsPerVnet(uint32_t consumerVcs) override
+    {
+        fatal_if(m_virt_nets * consumerVcs > Credit::MAX_VCS,
+                 "%s: credit words support at most %d VCs per link",
+                 name(), Credit::MAX_VCS);
+        NetworkLink::setVcsPerVnet(consumerVcs);
+    }
+
+    inline bool
+    isReady(Tick curTime)
+    {
+        if (!m_cross_region)
+            return creditBuffer.isReady(curTime);
+        std::lock_guard<std::mutex> lock(m_region_mutex);
+        return creditBuffer.isReady(curTime);
+    }
+
+    inline bool
+    isEmpty()
+    {
+        if (!m_cross_region)
+            return creditBuffer.isEmpty();
+        std::lock_guard<std::mutex> lock(m_region_mutex);
+        return creditBuffer.isEmpty();
+    }
+
+    inline Credit
+    consumeCredit()
+    {
+        if (!m_cross_region)
+            return creditBuffer.getTopCredit();
+        std::lock_guard<std::mutex> lock(m_region_mutex);
+        return creditBuffer.getTopCredit();
+    }
+
+  protected:
+    CreditBuffer creditBuffer;
+    CreditBuffer *credit_srcQueue;
 };
 
 } // namespace garnet
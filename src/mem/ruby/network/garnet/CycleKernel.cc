@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2026 The gem5 contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "mem/ruby/network/garnet/CycleKernel.hh"
+
+#include <algorithm>
+#include <cassert>
+
+#include "base/intmath.hh"
+
+namespace gem5
+{
+
+namespace ruby
+{
+
+namespace garnet
+{
+
+CycleKernel::CycleKernel(ClockedObject *clock, double threshold)
+    : m_clock(clock), m_threshold(threshold), m_cycle_driven(false),
+      m_next_cycle(0),
+      m_tick_event([this]{ tick(); }, "CycleKernel tick", false,
+                   Event::Default_Pri - 1),
+      m_window_start(0), m_window_wakeups(0), m_num_cycles(0),
+      m_num_switches(0)
+{
+}
+
+void
+CycleKernel::add_consumer(GarnetConsumer *consumer)
+{
+    assert(consumer->getObject()->clockPeriod() == m_clock->clockPeriod());
+    consumer->setKernel(this, m_consumers.size());
+    m_consumers.push_back(consumer);
+    m_pending.push_back(0);
+}
+
+void
+CycleKernel::schedule(int id, Tick when)
+{
+    Tick period = m_clock->clockPeriod();
+    uint64_t cycle = divCeil(when, period);
+
+    if (!m_cycle_driven) {
+        uint64_t now = m_clock->curCycle();
+        if (now - m_window_start >= WHEEL_CYCLES)
+            end_window(now);
+    }
+    m_window_wakeups++;
+
+    if (!m_cycle_driven || cycle < m_next_cycle ||
+        cycle - m_next_cycle >= WHEEL_CYCLES) {
+        m_consumers[id]->scheduleEventAbsolute(when);
+        return;
+    }
+
+    int slot = cycle % WHEEL_CYCLES;
+    if (m_pending[id] & (1ULL << slot))
+        return;
+    m_pending[id] |= (1ULL << slot);
+    m_worklists[slot].push_back(id);
+}
+
+void
+CycleKernel::tick()
+{
+    uint64_t cycle = m_next_cycle;
+    int slot = cycle % WHEEL_CYCLES;
+    assert(curTick() == cycle * m_clock->clockPeriod());
+
+    // Consumers may add themselves back to the current cycle while it is
+    // processed, like they can reschedule their event for the current tick
+    std::vector<int> &worklist = m_worklists[slot];
+    for (int i = 0; i < worklist.size(); i++) {
+        int id = worklist[i];
+        m_pending[id] &= ~(1ULL << slot);
+
+        // A wakeup also scheduled on the event queue for this tick (e.g.,
+        // before the kernel started) will do the work
+        GarnetConsumer *consumer = m_consumers[id];
+        if (!consumer->alreadyScheduled(curTick()))
+            consumer->wakeup();
+    }
+    worklist.clear();
+
+    m_next_cycle = cycle + 1;
+    m_num_cycles++;
+
+    if (m_next_cycle - m_window_start >= WHEEL_CYCLES)
+        end_window(m_next_cycle);
+    if (m_cycle_driven) {
+        m_clock->schedule(m_tick_event,
+                          m_next_cycle * m_clock->clockPeriod());
+    }
+}
+
+void
+CycleKernel::end_window(uint64_t cycle)
+{
+    bool dense = m_window_wakeups >=
+        m_threshold * m_consumers.size() * (cycle - m_window_start);
+
+    if (dense && !m_cycle_driven)
+        start_cycle_driven(cycle);
+    else if (!dense && m_cycle_driven)
+        stop_cycle_driven();
+
+    m_window_start = cycle;
+    m_window_wakeups = 0;
+}
+
+// Called from the event queue at cycle now, so the kernel takes over
+// from the next cycle on
+void
+CycleKernel::start_cycle_driven(uint64_t now)
+{
+    m_cycle_driven = true;
+    m_next_cycle = now + 1;
+    m_num_switches++;
+    m_clock->schedule(m_tick_event, m_next_cycle * m_clock->clockPeriod());
+}
+
+// Called at the end of a tick, before the next cycle is processed
+void
+CycleKernel::stop_cycle_driven()
+{
+    Tick period = m_clock->clockPeriod();
+    for (uint64_t cycle = m_next_cycle;
+         cycle < m_next_cycle + WHEEL_CYCLES; cycle++) {
+        std::vector<int> &worklist = m_worklists[cycle % WHEEL_CYCLES];
+        for (int id : worklist) {
+            m_consumers[id]->scheduleEventAbsolute(cycle * period);
+        }
+        worklist.clear();
+    }
+    std::fill(m_pending.begin(), m_pending.end(), 0);
+
+    m_cycle_driven = false;
+    m_num_switches++;
+}
+
+void
+CycleKernel::resetStats()
+{
+    m_num_cycles = 0;
+    m_num_switches = 0;
+}
+
+} // namespace garnet
+} // namespace ruby
+} // namespace gem5
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2026 The gem5 contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __MEM_RUBY_NETWORK_GARNET_0_CYCLEKERNEL_HH__
+#define __MEM_RUBY_NETWORK_GARNET_0_CYCLEKERNEL_HH__
+
+#include <cstdint>
+#include <vector>
+
+#include "mem/ruby/common/Consumer.hh"
+#include "sim/clocked_object.hh"
+
+namespace gem5
+{
+
+namespace ruby
+{
+
+namespace garnet
+{
+
+class CycleKernel;
+
+// Routers, links and network interfaces schedule their own wakeups
+// through scheduleWakeup(), which goes to the cycle-driven kernel of the
+// network when they are registered with it, and to the event queue
+// otherwise. Wakeups scheduled from outside the network (e.g., by message
+// buffers) keep using the Consumer interface.
+class GarnetConsumer : public Consumer
+{
+  public:
+    GarnetConsumer(ClockedObject *em)
+        : Consumer(em), m_kernel(nullptr), m_kernel_id(-1)
+    {}
+
+    void
+    setKernel(CycleKernel *kernel, int id)
+    {
+        m_kernel = kernel;
+        m_kernel_id = id;
+    }
+
+    void scheduleWakeupAbsolute(Tick when);
+    void
+    scheduleWakeup(Cycles delta)
+    {
+        scheduleWakeupAbsolute(getObject()->clockEdge(delta));
+    }
+
+  private:
+    CycleKernel *m_kernel;
+    int m_kernel_id;
+};
+
+// Cycle-driven execution of a dense network. Instead of one event per
+// wakeup, the kernel keeps the wakeups of the next WHEEL_CYCLES cycles in
+// a wheel of worklists and one event per cycle wakes up the consumers of
+// the current cycle, in the order they were scheduled.
+//
+// The kernel watches the number of wakeups over windows of WHEEL_CYCLES
+// cycles. Below threshold wakeups per registered consumer and per cycle,
+// it hands its worklists back to the event queue and stops ticking; above
+// it, it starts ticking again. Wakeups further than the wheel, or for a
+// cycle that was already processed, always go to the event queue.
+class CycleKernel
+{
+  public:
+    CycleKernel(ClockedObject *clock, double threshold);
+
+    void add_consumer(GarnetConsumer *consumer);
+    int get_num_consumers() { return m_consumers.size(); }
+    void schedule(int id, Tick when);
+
+    bool is_cycle_driven() { return m_cycle_driven; }
+    uint64_t get_num_cycles() { return m_num_cycles; }
+    uint64_t get_num_switches() { return m_num_switches; }
+    void resetStats();
+
+  private:
+    static const int WHEEL_CYCLES = 64;
+
+    void tick();
+    void end_window(uint64_t cycle);
+    void start_cycle_driven(uint64_t cycle);
+    void stop_cycle_driven();
+
+    ClockedObject *m_clock;
+    const double m_threshold;
+
+    std::vector<GarnetConsumer *> m_consumers;
+    // Bit (cycle % WHEEL_CYCLES) of a consumer is set while it is in the
+    // worklist of that cycle
+    std::vector<uint64_t> m_pending;
+    std::vector<int> m_worklists[WHEEL_CYCLES];
+
+    bool m_cycle_driven;
+    // First cycle whose worklist has not been processed yet
+    uint64_t m_next_cycle;
+    EventFunctionWrapper m_tick_event;
+
+    uint64_t m_window_start;
+    uint64_t m_window_wakeups;
+
+    uint64_t m_num_cycles;
+    uint64_t m_num_switches;
+};
+
+inline void
+GarnetConsumer::scheduleWakeupAbsolute(Tick when)
+{
+    if (m_kernel)
+        m_kernel->schedule(m_kernel_id, when);
+    else
+        scheduleEventAbsolute(when);
+}
+
+} // namespace garnet
+} // namespace ruby
+} // namespace gem5
+
+#endif // __MEM_RUBY_NETWORK_GARNET_0_CYCLEKERNEL_HH__
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2026 The gem5 contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "mem/ruby/network/garnet/FlitPool.hh"
+
+#include <algorithm>
+#include <cassert>
+
+#include "mem/ruby/network/garnet/flit.hh"
+
+namespace gem5
+{
+
+namespace ruby
+{
+
+namespace garnet
+{
+
+namespace
+{
+
+constexpr std::size_t
+roundUpToAlign(std::size_t size)
+{
+    return (size + alignof(std::max_align_t) - 1) &
+           ~(alignof(std::max_align_t) - 1);
+}
+
+} // anonymous namespace
+
+// The header keeps the objects aligned like the system allocator would
+const std::size_t FlitPool::HEADER_SIZE = roundUpToAlign(sizeof(FlitPool *));
+const std::size_t FlitPool::BLOCK_SIZE = FlitPool::HEADER_SIZE +
+    roundUpToAlign(std::max(sizeof(flit), sizeof(RouteInfo)));
+
+FlitPool::FlitPool()
+    : m_shared(false), m_free_list(nullptr), m_released(nullptr),
+      m_num_allocs(0), m_num_slab_allocs(0)
+{
+}
+
+void
+FlitPool::allocate_slab()
+{
+    char *slab = new char[SLAB_BLOCKS * BLOCK_SIZE];
+    m_slabs.emplace_back(slab);
+    m_num_slab_allocs++;
+
+    for (int i = SLAB_BLOCKS - 1; i >= 0; i--) {
+        char *block = slab + i * BLOCK_SIZE;
+        *reinterpret_cast<FlitPool **>(block) = this;
+        FreeBlock *free_block =
+            reinterpret_cast<FreeBlock *>(block + HEADER_SIZE);
+        free_block->next = m_free_list;
+        m_free_list = free_block;
+    }
+}
+
+void *
+FlitPool::allocate(std::size_t size)
+{
+    assert(size + HEADER_SIZE <= BLOCK_SIZE);
+
+    // Take back all the blocks released so far before growing the pool
+    if (m_free_list == nullptr && m_shared)
+        m_free_list = m_released.exchange(nullptr, std::memory_order_acquire);
+    if (m_free_list == nullptr)
+        allocate_slab();
+
+    FreeBlock *free_block = m_free_list;
+    m_free_list = free_block->next;
+    m_num_allocs++;
+    return free_block;
+}
+
+void
+FlitPool::release(void *ptr)
+{
+    if (ptr == nullptr)
+        return;
+
+    FlitPool *pool = owner(ptr);
+    FreeBlock *free_block = static_cast<FreeBlock *>(ptr);
+    if (!pool->m_shared) {
+        free_block->next = pool->m_free_list;
+        pool->m_free_list = free_block;
+        return;
+    }
+
+    // Blocks are only pushed here and taken all at once by the owner, so
+    // the list cannot suffer from ABA
+    FreeBlock *head = pool->m_released.load(std::memory_order_relaxed);
+    do {
+        free_block->next = head;
+    } while (!pool->m_released.compare_exchange_weak(
+                 head, free_block, std::memory_order_release,
+                 std::memory_order_relaxed));
+}
+
+FlitPool *
+FlitPool::owner(const void *ptr)
+{
+    const char *block = static_cast<const char *>(ptr) - HEADER_SIZE;
+    return *reinterpret_cast<FlitPool * const *>(block);
+}
+
+void
+FlitPool::resetStats()
+{
+    m_num_allocs = 0;
+    m_num_slab_allocs = 0;
+}
+
+} // namespace garnet
+} // namespace ruby
+} // namespace gem5
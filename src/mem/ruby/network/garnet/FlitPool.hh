@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2026 The gem5 contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __MEM_RUBY_NETWORK_GARNET_0_FLITPOOL_HH__
+#define __MEM_RUBY_NETWORK_GARNET_0_FLITPOOL_HH__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace gem5
+{
+
+namespace ruby
+{
+
+namespace garnet
+{
+
+// Slab allocator for the flits and routes of one region of a
+// GarnetNetwork.
+// Blocks are carved out of slabs of SLAB_BLOCKS blocks and recycled through
+// a free list, so the system allocator is only used while the number of
+// flits in flight grows. Every block starts with a pointer back to its
+// pool, which lets operator delete and flit::serialize() find the pool of
+// any flit or route.
+// Only the thread of its region allocates from a pool, but in a network
+// split into several regions a flit may be released by the thread of
+// another region. A shared pool takes those blocks back on a lock-free
+// list, which the owner moves to its free list once that runs empty.
+class FlitPool
+{
+  public:
+    FlitPool();
+    ~FlitPool() = default;
+
+    void *allocate(std::size_t size);
+    static void release(void *ptr);
+    static FlitPool *owner(const void *ptr);
+    void setShared(bool shared) { m_shared = shared; }
+    bool isShared() const { return m_shared; }
+
+    uint64_t get_num_allocs() { return m_num_allocs; }
+    uint64_t get_num_slab_allocs() { return m_num_slab_allocs; }
+    void resetStats();
+
+  private:
+    FlitPool(const FlitPool& obj);
+    FlitPool& operator=(const FlitPool& obj);
+
+    void allocate_slab();
+
+    static const int SLAB_BLOCKS = 1024;
+    static const std::size_t HEADER_SIZE;
+    static const std::size_t BLOCK_SIZE;
+
+    // Free blocks are linked through their first word
+    struct FreeBlock
+    {
+        FreeBlock *next;
+    };
+
+    bool m_shared;
+
+    FreeBlock *m_free_list;
+    // Blocks released to a shared pool, possibly by other threads
+    std::atomic<FreeBlock *> m_released;
+    std::vector<std::unique_ptr<char[]>> m_slabs;
+
+    uint64_t m_num_allocs;
+    uint64_t m_num_slab_allocs;
+};
+
+} // namespace garnet
+} // namespace ruby
+} // namespace gem5
+
+#endif // __MEM_RUBY_NETWORK_GARNET_0_FLITPOOL_HH__
@@ -31,10 +31,13 @@
 
 #include "mem/ruby/network/garnet/GarnetNetwork.hh"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 
 #include "base/cast.hh"
 #include "base/compiler.hh"
+#include "base/intmath.hh"
 #include "debug/RubyNetwork.hh"
 #include "mem/ruby/common/NetDest.hh"
 #include "mem/ruby/network/MessageBuffer.hh"
@@ -62,7 +65,10 @@ namespace garnet
  */
 
 GarnetNetwork::GarnetNetwork(const Params &p)
-    : Network(p)
+    : Network(p), m_cycle_kernel(this, p.cycle_driven_threshold),
+      m_packets_in_flight(0),
+      m_multicast_copies_sent(0), m_multicast_copies_delivered(0),
+      m_routing_build_seconds(0)
 {
     m_num_rows = p.num_rows;
     m_num_xs = p.num_xs;
@@ -72,8 +78,41 @@ GarnetNetwork::GarnetNetwork(const Params &p)
     m_buffers_per_data_vc = p.buffers_per_data_vc;
     m_buffers_per_ctrl_vc = p.buffers_per_ctrl_vc;
     m_routing_algorithm = p.routing_algorithm;
+    m_torus_route_table_limit = p.torus_route_table_limit;
+    m_torus_selection = p.torus_selection;
+    m_vc_classes = p.vc_classes;
+    m_random_seed = p.random_seed;
+    m_num_regions = p.num_regions;
+    // A flit may be released by the thread of another region than its own
+    for (int region = 0; region < std::max(m_num_regions, 1u); region++) {
+        m_flit_pools.emplace_back(new FlitPool());
+        m_flit_pools.back()->setShared(m_num_regions > 1);
+    }
+    m_cycle_driven = p.cycle_driven;
     m_next_packet_id = 0;
+    m_multicast = p.multicast;
     m_wormhole = p.wormhole;
+    m_virtual_cut_through = p.virtual_cut_through;
+    m_lookahead_routing = p.lookahead_routing;
+    m_speculative_sa = p.speculative_sa;
+
+    fatal_if(m_wormhole && m_speculative_sa,
+             "Speculative SA is not supported with wormhole flow control.");
+    fatal_if(m_wormhole && m_virtual_cut_through,
+             "Wormhole and virtual cut-through flow control are exclusive.");
+    fatal_if(m_wormhole && m_multicast,
+             "Multicast is not supported with wormhole flow control.");
+
+    // Fixed ids of the direction names used by the routing algorithms,
+    // in the order of port_direction_type
+    const char *builtin_dirns[NUM_BUILTIN_DIRN_] = {
+        "Local", "North", "South", "East", "West", "Left", "Right",
+        "Front", "Back", "Up", "Down"};
+    for (int dirn = 0; dirn < NUM_BUILTIN_DIRN_; dirn++) {
+        [[maybe_unused]] PortDirectionId id =
+            internPortDirection(builtin_dirns[dirn]);
+        assert(id == dirn);
+    }
 
     m_enable_fault_model = p.enable_fault_model;
     if (m_enable_fault_model)
@@ -122,8 +161,45 @@ GarnetNetwork::init()
     // The topology pointer should have already been initialized in the
     // parent network constructor
     assert(m_topology_ptr != NULL);
+    auto build_start = std::chrono::steady_clock::now();
     m_topology_ptr->createLinks(this);
 
+    // The routing tables are complete, precompute the candidate outports
+    // of each destination
+    for (auto &router : m_routers) {
+        router->init_dest_table();
+    }
+    m_routing_build_seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - build_start).count();
+
+    fatal_if(m_num_regions < 1 || m_num_regions > m_routers.size(),
+             "num_regions must be between 1 and the number of routers.");
+    if (m_num_regions > 1)
+        partitionRegions();
+
+    // Under virtual cut-through a head flit waits for room for its whole
+    // packet, so every VC must hold the largest packet at every router
+    if (m_virtual_cut_through) {
+        for (auto &router : m_routers) {
+            int width = router->getBitWidth();
+            fatal_if(divCeil(m_data_msg_size, width) > m_buffers_per_data_vc,
+                     "Virtual cut-through: router %d needs %d buffers per "
+                     "data VC to hold a data packet.", router->get_id(),
+                     divCeil(m_data_msg_size, width));
+            fatal_if(divCeil(m_control_msg_size, width) >
+                     m_buffers_per_ctrl_vc,
+                     "Virtual cut-through: router %d needs %d buffers per "
+                     "ctrl VC to hold a control packet.", router->get_id(),
+                     divCeil(m_control_msg_size, width));
+        }
+    }
+
+    if (m_cycle_driven) {
+        fatal_if(m_num_regions > 1,
+                 "The cycle-driven network does not support num_regions > 1.");
+        registerCycleKernel();
+    }
+
     // Initialize topology specific parameters
     if (getNumRows() > 0) {
         // Only for Mesh topology
@@ -150,6 +226,27 @@ GarnetNetwork::init()
         m_num_zs = -1;
     }
 
+    if (getRoutingAlgorithm() == XYZ_) {
+        fatal_if(m_num_zs <= 0, "XYZ routing requires a 3D torus topology "
+                 "(see num_xs and num_ys)");
+
+        // The 3D torus routes only depend on the (current, destination)
+        // router pair. Precompute them unless the tables of all routers
+        // together would exceed torus_route_table_limit.
+        uint64_t table_bytes = (uint64_t)m_routers.size() *
+            m_routers.size() * sizeof(OutportCandidates);
+        bool build_table = (table_bytes <= m_torus_route_table_limit);
+        if (!build_table) {
+            warn("3D torus route tables need %llu bytes, more than the "
+                 "%llu bytes limit. Routes will be computed per flit.\n",
+                 table_bytes, m_torus_route_table_limit);
+        }
+
+        for (auto &router : m_routers) {
+            router->init_torus_routing(build_table);
+        }
+    }
+
     // FaultModel: declare each router to the fault model
     if (isFaultModelEnabled()) {
         for (std::vector<Router*>::const_iterator i= m_routers.begin();
@@ -192,7 +289,7 @@ GarnetNetwork::makeExtInLink(NodeID global_src, SwitchID dest, BasicLink* link,
     m_networklinks.push_back(net_link);
     m_creditlinks.push_back(credit_link);
 
-    PortDirection dst_inport_dirn = "Local";
+    PortDirectionId dst_inport_dirn = LOCAL_DIRN_;
 
     m_max_vcs_per_vnet = std::max(m_max_vcs_per_vnet,
                              m_routers[dest]->get_vc_per_vnet());
@@ -224,6 +321,12 @@ GarnetNetwork::makeExtInLink(NodeID global_src, SwitchID dest, BasicLink* link,
             m_routers[dest]->get_vc_per_vnet());
     }
 
+    // A flit the NI sends is serialized into up to flits_per_credit flits
+    // of the router, which the NI holds a single credit for
+    int ni_width = garnet_link->extBridgeEn ?
+        garnet_link->extNetBridge[LinkDirection_In]->bitWidth :
+        net_link->bitWidth;
+    int flits_per_credit = divCeil(ni_width, m_routers[dest]->getBitWidth());
     if (garnet_link->intBridgeEn) {
         DPRINTF(RubyNetwork, "Enable internal bridge for %s\n",
             garnet_link->name());
@@ -231,10 +334,12 @@ GarnetNetwork::makeExtInLink(NodeID global_src, SwitchID dest, BasicLink* link,
         m_routers[dest]->
             addInPort(dst_inport_dirn,
                       n_bridge,
-                      garnet_link->intCredBridge[LinkDirection_In]);
+                      garnet_link->intCredBridge[LinkDirection_In],
+                      flits_per_credit);
         m_networkbridges.push_back(n_bridge);
     } else {
-        m_routers[dest]->addInPort(dst_inport_dirn, net_link, credit_link);
+        m_routers[dest]->addInPort(dst_inport_dirn, net_link, credit_link,
+                                   flits_per_credit);
     }
 
 }
@@ -265,7 +370,7 @@ GarnetNetwork::makeExtOutLink(SwitchID src, NodeID global_dest,
     m_networklinks.push_back(net_link);
     m_creditlinks.push_back(credit_link);
 
-    PortDirection src_outport_dirn = "Local";
+    PortDirectionId src_outport_dirn = LOCAL_DIRN_;
 
     m_max_vcs_per_vnet = std::max(m_max_vcs_per_vnet,
                              m_routers[src]->get_vc_per_vnet());
@@ -322,11 +427,16 @@ GarnetNetwork::makeExtOutLink(SwitchID src, NodeID global_dest,
 void
 GarnetNetwork::makeInternalLink(SwitchID src, SwitchID dest, BasicLink* link,
                                 std::vector<NetDest>& routing_table_entry,
-                                PortDirection src_outport_dirn,
-                                PortDirection dst_inport_dirn)
+                                PortDirection src_outport_dirn_name,
+                                PortDirection dst_inport_dirn_name)
 {
     GarnetIntLink* garnet_link = safe_cast<GarnetIntLink*>(link);
 
+    PortDirectionId src_outport_dirn =
+        internPortDirection(src_outport_dirn_name);
+    PortDirectionId dst_inport_dirn =
+        internPortDirection(dst_inport_dirn_name);
+
     // GarnetIntLink is unidirectional
     NetworkLink* net_link = garnet_link->m_network_link;
     net_link->setType(INT_);
@@ -352,15 +462,21 @@ GarnetNetwork::makeInternalLink(SwitchID src, SwitchID dest, BasicLink* link,
      * bridge is enabled, we would connect:
      * Router--->NetworkBridge--->GarnetIntLink---->Router
      */
+    // A flit of src is serialized into up to flits_per_credit flits of
+    // dest, which src holds a single credit for
+    int flits_per_credit = divCeil(m_routers[src]->getBitWidth(),
+                                   m_routers[dest]->getBitWidth());
     if (garnet_link->dstBridgeEn) {
         DPRINTF(RubyNetwork, "Enable destination bridge for %s\n",
             garnet_link->name());
         NetworkBridge *n_bridge = garnet_link->dstNetBridge;
         m_routers[dest]->addInPort(dst_inport_dirn, n_bridge,
-                                   garnet_link->dstCredBridge);
+                                   garnet_link->dstCredBridge,
+                                   flits_per_credit);
         m_networkbridges.push_back(n_bridge);
     } else {
-        m_routers[dest]->addInPort(dst_inport_dirn, net_link, credit_link);
+        m_routers[dest]->addInPort(dst_inport_dirn, net_link, credit_link,
+                                   flits_per_credit);
     }
 
     if (garnet_link->srcBridgeEn) {
@@ -381,6 +497,88 @@ GarnetNetwork::makeInternalLink(SwitchID src, SwitchID dest, BasicLink* link,
     }
 }
 
+// The network is drained once every packet injected has been handed to a
+// protocol buffer. It keeps accepting messages while it drains, as the
+// protocol may need them to complete its outstanding transactions, so it
+// only drains once the requestors stop issuing.
+DrainState
+GarnetNetwork::drain()
+{
+    if (m_packets_in_flight == 0) {
+        assert(m_multicast_deliveries.empty());
+        assert(m_multicast_copies_delivered == m_multicast_copies_sent);
+        return DrainState::Drained;
+    }
+
+    DPRINTF(RubyNetwork, "Draining with %d packets in flight\n",
+            m_packets_in_flight);
+    return DrainState::Draining;
+}
+
+void
+GarnetNetwork::decrement_packets_in_flight()
+{
+    assert(m_packets_in_flight > 0);
+    if (--m_packets_in_flight == 0 && drainState() == DrainState::Draining)
+        signalDrainDone();
+}
+
+void
+GarnetNetwork::add_multicast_packet(int packet_id, int copies)
+{
+    bool inserted =
+        m_multicast_deliveries.emplace(packet_id,
+                                       MulticastDelivery{copies, 0}).second;
+    assert(inserted);
+    m_multicast_copies_sent += copies;
+}
+
+// A copy of multicast packet packet_id reached its destination after
+// hops hops. Returns true for the last copy, with the most hops any
+// copy took in max_hops.
+bool
+GarnetNetwork::deliver_multicast_copy(int packet_id, int hops,
+                                      int &max_hops)
+{
+    m_multicast_copies_received++;
+    m_multicast_copies_delivered++;
+
+    auto it = m_multicast_deliveries.find(packet_id);
+    assert(it != m_multicast_deliveries.end());
+    MulticastDelivery &delivery = it->second;
+    assert(delivery.copies > 0);
+    delivery.max_hops = std::max(delivery.max_hops, hops);
+    if (--delivery.copies > 0)
+        return false;
+
+    max_hops = delivery.max_hops;
+    m_multicast_deliveries.erase(it);
+    // Every copy of every multicast packet injected so far has arrived
+    assert(!m_multicast_deliveries.empty() ||
+           m_multicast_copies_delivered == m_multicast_copies_sent);
+    return true;
+}
+
+PortDirectionId
+GarnetNetwork::internPortDirection(const PortDirection &dirn)
+{
+    auto it = m_port_dirn_ids.find(dirn);
+    if (it != m_port_dirn_ids.end())
+        return it->second;
+
+    PortDirectionId id = m_port_dirn_names.size();
+    m_port_dirn_names.push_back(dirn);
+    m_port_dirn_ids[dirn] = id;
+    return id;
+}
+
+const PortDirection &
+GarnetNetwork::getPortDirectionName(PortDirectionId dirn) const
+{
+    assert(dirn >= 0 && dirn < m_port_dirn_names.size());
+    return m_port_dirn_names[dirn];
+}
+
 // Total routers in the network
 int
 GarnetNetwork::getNumRouters()
@@ -388,6 +586,116 @@ GarnetNetwork::getNumRouters()
     return m_routers.size();
 }
 
+// Region of a router: routers are split in slabs of consecutive ids,
+// which keeps neighbouring routers of the mesh and torus topologies in the
+// same region
+int
+GarnetNetwork::getRouterRegion(int router_id) const
+{
+    return (uint64_t)router_id * m_num_regions / m_routers.size();
+}
+
+// VCs of a vnet with vcs_per_vnet VCs that are in one of vc_classes,
+// bit i set for VC i of the vnet
+uint64_t
+GarnetNetwork::getVcClassVcs(uint32_t vcs_per_vnet,
+                             VcClassMask vc_classes) const
+{
+    if (m_vc_classes.empty()) {
+        uint64_t vcs = 0;
+        if (vc_classes & vcClassBit(GarnetVcClass::adaptive))
+            vcs |= mask(vcs_per_vnet / 2);
+        if (vc_classes & vcClassBit(GarnetVcClass::escape))
+            vcs |= mask(vcs_per_vnet) & ~mask(vcs_per_vnet / 2);
+        return vcs;
+    }
+
+    fatal_if(m_vc_classes.size() != vcs_per_vnet,
+             "vc_classes gives the class of %d VCs per vnet, but a port "
+             "has %d VCs per vnet", m_vc_classes.size(), vcs_per_vnet);
+    uint64_t vcs = 0;
+    for (int vc = 0; vc < vcs_per_vnet; vc++) {
+        if (vc_classes & vcClassBit(m_vc_classes[vc]))
+            vcs |= (uint64_t)1 << vc;
+    }
+    return vcs;
+}
+
+// Region of a link end. Network interfaces stay in region 0 with the
+// protocol controllers, which are not thread safe.
+int
+GarnetNetwork::getObjectRegion(ClockedObject *obj) const
+{
+    Router *router = dynamic_cast<Router *>(obj);
+    return router ? getRouterRegion(router->get_id()) : 0;
+}
+
+/*
+ * Each region may run on its own event queue (see eventq_index in
+ * configs/network/Network.py). The links between two regions are the
+ * only place where two queues interact: a link runs on the queue of its
+ * producer, and its latency must cover the simulation quantum so that a
+ * flit or credit always becomes visible to the consumer in a later
+ * quantum. Regions do not depend on the number of queues, so results are
+ * the same for any number of threads.
+ */
+void
+GarnetNetwork::partitionRegions()
+{
+    fatal_if(!m_networkbridges.empty(),
+             "Network bridges are not supported with num_regions > 1.");
+
+    std::vector<NetworkLink *> links(m_networklinks);
+    links.insert(links.end(), m_creditlinks.begin(), m_creditlinks.end());
+
+    int num_cross_region_links = 0;
+    for (auto &link : links) {
+        ClockedObject *src = link->getSourceObject();
+        ClockedObject *dst = link->getLinkConsumer()->getObject();
+
+        fatal_if(link->eventQueue() != src->eventQueue(),
+                 "%s must be on the event queue of its source %s.",
+                 link->name(), src->name());
+
+        if (getObjectRegion(src) == getObjectRegion(dst)) {
+            fatal_if(src->eventQueue() != dst->eventQueue(),
+                     "%s and %s are in the same region but on different "
+                     "event queues.", src->name(), dst->name());
+            continue;
+        }
+
+        fatal_if(numMainEventQueues > 1 &&
+                 link->cyclesToTicks(link->getLatency()) < simQuantum,
+                 "%s connects two regions and its latency is less than "
+                 "the simulation quantum.", link->name());
+        link->setCrossRegion();
+        num_cross_region_links++;
+    }
+
+    inform("Garnet network split into %d regions, %d links between "
+           "regions\n", m_num_regions, num_cross_region_links);
+}
+
+// Hand the routers, links and network interfaces over to the cycle-driven
+// kernel. Objects in another clock domain than the network (e.g., behind
+// a clock domain crossing) keep their own wakeup events.
+void
+GarnetNetwork::registerCycleKernel()
+{
+    std::vector<GarnetConsumer *> consumers(m_routers.begin(),
+                                            m_routers.end());
+    consumers.insert(consumers.end(), m_nis.begin(), m_nis.end());
+    consumers.insert(consumers.end(), m_networklinks.begin(),
+                     m_networklinks.end());
+    consumers.insert(consumers.end(), m_creditlinks.begin(),
+                     m_creditlinks.end());
+
+    for (auto &consumer : consumers) {
+        if (consumer->getObject()->clockPeriod() == clockPeriod())
+            m_cycle_kernel.add_consumer(consumer);
+    }
+}
+
 // Get ID of router connected to a NI.
 int
 GarnetNetwork::get_router_id(int global_ni, int vnet)
@@ -397,6 +705,22 @@ GarnetNetwork::get_router_id(int global_ni, int vnet)
     return m_nis[local_ni]->get_router_id(vnet);
 }
 
+// Destination set holding only the given node
+NetDest
+GarnetNetwork::getNodeDest(NodeID node) const
+{
+    NetDest node_dest;
+    for (int m = 0; m < (int) MachineType_NUM; m++) {
+        if ((node >= MachineType_base_number((MachineType) m)) &&
+            node < MachineType_base_number((MachineType) (m+1))) {
+            node_dest.add((MachineID) {(MachineType) m, (node -
+                MachineType_base_number((MachineType) m))});
+            break;
+        }
+    }
+    return node_dest;
+}
+
 void
 GarnetNetwork::regStats()
 {
@@ -528,6 +852,37 @@ GarnetNetwork::regStats()
     m_avg_hops.name(name() + ".average_hops");
     m_avg_hops = m_total_hops / sum(m_flits_received);
 
+    // Multicast: packets and flits injected for multicast messages,
+    // against the flits of one unicast packet per destination
+    m_multicast_packets
+        .name(name() + ".multicast_packets");
+    m_multicast_flits_injected
+        .name(name() + ".multicast_flits_injected");
+    m_multicast_unicast_flits
+        .name(name() + ".multicast_unicast_flits");
+    m_multicast_flit_ratio
+        .name(name() + ".multicast_flit_ratio");
+    m_multicast_flit_ratio =
+        m_multicast_flits_injected / m_multicast_unicast_flits;
+    m_multicast_copies_received
+        .name(name() + ".multicast_copies_received");
+
+    // Flit allocation: flits taken from the flit pools of all regions,
+    // and slabs the pools had to take from the system allocator
+    m_flit_pool_allocs
+        .name(name() + ".flit_pool_allocs");
+    m_flit_pool_slab_allocs
+        .name(name() + ".flit_pool_slab_allocs");
+
+    m_cycle_driven_cycles
+        .name(name() + ".cycle_driven_cycles");
+    m_cycle_driven_switches
+        .name(name() + ".cycle_driven_switches");
+
+    // Host seconds taken by the shortest paths and routing tables
+    m_routing_table_build_time
+        .name(name() + ".routing_table_build_time");
+
     // Links
     m_total_ext_in_link_utilization
         .name(name() + ".ext_in_link_utilization");
@@ -592,6 +947,16 @@ GarnetNetwork::collateStats()
         }
     }
 
+    m_flit_pool_allocs = 0;
+    m_flit_pool_slab_allocs = 0;
+    for (auto &pool : m_flit_pools) {
+        m_flit_pool_allocs += pool->get_num_allocs();
+        m_flit_pool_slab_allocs += pool->get_num_slab_allocs();
+    }
+    m_cycle_driven_cycles = m_cycle_kernel.get_num_cycles();
+    m_cycle_driven_switches = m_cycle_kernel.get_num_switches();
+    m_routing_table_build_time = m_routing_build_seconds;
+
     // Ask the routers to collate their statistics
     for (int i = 0; i < m_routers.size(); i++) {
         m_routers[i]->collateStats();
@@ -610,6 +975,9 @@ GarnetNetwork::resetStats()
     for (int i = 0; i < m_creditlinks.size(); i++) {
         m_creditlinks[i]->resetStats();
     }
+    for (auto &pool : m_flit_pools)
+        pool->resetStats();
+    m_cycle_kernel.resetStats();
 }
 
 void
@@ -619,12 +987,25 @@ GarnetNetwork::print(std::ostream& out) const
 }
 
 void
-GarnetNetwork::update_traffic_distribution(RouteInfo route)
+GarnetNetwork::update_traffic_distribution(const RouteInfo &route)
 {
     int src_node = route.src_router;
     int dest_node = route.dest_router;
     int vnet = route.vnet;
 
+    if (route.multicast) {
+        // Count the multicast towards each of its destinations
+        NetDest dests = *route.net_dest;
+        for (NodeID node : dests.getAllDest()) {
+            RouteInfo node_route;
+            node_route.copyHeader(route);
+            node_route.dest_router = get_router_id(node, vnet);
+            node_route.multicast = false;
+            update_traffic_distribution(node_route);
+        }
+        return;
+    }
+
     if (m_vnet_type[vnet] == DATA_VNET_)
         (*m_data_traffic_distribution[src_node][dest_node])++;
     else
@@ -33,11 +33,15 @@
 #define __MEM_RUBY_NETWORK_GARNET_0_GARNETNETWORK_HH__
 
 #include <iostream>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include "mem/ruby/network/Network.hh"
 #include "mem/ruby/network/fault_model/FaultModel.hh"
 #include "mem/ruby/network/garnet/CommonTypes.hh"
+#include "mem/ruby/network/garnet/CycleKernel.hh"
+#include "mem/ruby/network/garnet/FlitPool.hh"
 #include "params/GarnetNetwork.hh"
 
 namespace gem5
@@ -85,12 +89,26 @@ class GarnetNetwork : public Network
     uint32_t getBuffersPerDataVC() { return m_buffers_per_data_vc; }
     uint32_t getBuffersPerCtrlVC() { return m_buffers_per_ctrl_vc; }
     int getRoutingAlgorithm() const { return m_routing_algorithm; }
+    uint64_t getTorusRouteTableLimit() const
+    { return m_torus_route_table_limit; }
+    GarnetTorusSelection getTorusSelection() const
+    { return m_torus_selection; }
+    uint64_t getVcClassVcs(uint32_t vcs_per_vnet,
+                           VcClassMask vc_classes) const;
+    uint64_t getRandomSeed() const { return m_random_seed; }
+    uint32_t getNumRegions() const { return m_num_regions; }
+    int getRouterRegion(int router_id) const;
 
     bool isFaultModelEnabled() const { return m_enable_fault_model; }
     FaultModel* fault_model;
 
+    bool isMulticastEnabled() const { return m_multicast; }
     bool isWormholeEnabled() const { return m_wormhole; }
+    bool isVirtualCutThrough() const { return m_virtual_cut_through; }
+    bool isLookaheadRouting() const { return m_lookahead_routing; }
+    bool isSpeculativeSA() const { return m_speculative_sa; }
 
+    DrainState drain() override;
 
     // Internal configuration
     bool isVNetOrdered(int vnet) const { return m_ordered[vnet]; }
@@ -101,6 +119,7 @@ class GarnetNetwork : public Network
     }
     int getNumRouters();
     int get_router_id(int ni, int vnet);
+    NetDest getNodeDest(NodeID node) const;
 
 
     // Methods used by Topology to setup the network
@@ -113,6 +132,10 @@ class GarnetNetwork : public Network
                           PortDirection src_outport_dirn,
                           PortDirection dest_inport_dirn);
 
+    // Port direction names are only used while building the topology
+    PortDirectionId internPortDirection(const PortDirection &dirn);
+    const PortDirection &getPortDirectionName(PortDirectionId dirn) const;
+
     bool functionalRead(Packet *pkt, WriteMask &mask);
     //! Function for performing a functional write. The return value
     //! indicates the number of messages that were written.
@@ -161,9 +184,36 @@ class GarnetNetwork : public Network
         m_total_hops += hops;
     }
 
-    void update_traffic_distribution(RouteInfo route);
+    // A packet of a multicast message was injected with injected_flits
+    // flits, where unicast packets to each destination take unicast_flits
+    void
+    increment_multicast_flits(int injected_flits, int unicast_flits)
+    {
+        m_multicast_packets++;
+        m_multicast_flits_injected += injected_flits;
+        m_multicast_unicast_flits += unicast_flits;
+    }
+
+    // The copies of a multicast packet reaching its destinations count
+    // as one received packet, see NetworkInterface::incrementStats
+    void add_multicast_packet(int packet_id, int copies);
+    bool deliver_multicast_copy(int packet_id, int hops, int &max_hops);
+
+    // Packets injected and not yet handed to a protocol buffer, a
+    // multicast packet counting once per destination
+    void
+    increment_packets_in_flight(int count)
+    {
+        m_packets_in_flight += count;
+    }
+    void decrement_packets_in_flight();
+
+    void update_traffic_distribution(const RouteInfo &route);
     int getNextPacketID() { return m_next_packet_id++; }
 
+    // The flits of each region are allocated from its own pool
+    FlitPool &getFlitPool(int region) { return *m_flit_pools[region]; }
+
   protected:
     // Configuration
     int m_num_rows;
@@ -176,8 +226,18 @@ class GarnetNetwork : public Network
     uint32_t m_buffers_per_ctrl_vc;
     uint32_t m_buffers_per_data_vc;
     int m_routing_algorithm;
+    uint64_t m_torus_route_table_limit;
+    GarnetTorusSelection m_torus_selection;
+    std::vector<GarnetVcClass> m_vc_classes;
+    uint64_t m_random_seed;
+    uint32_t m_num_regions;
+    bool m_cycle_driven;
     bool m_enable_fault_model;
+    bool m_multicast;
     bool m_wormhole;
+    bool m_virtual_cut_through;
+    bool m_lookahead_routing;
+    bool m_speculative_sa;
 
     // Statistical variables
     statistics::Vector m_packets_received;
@@ -211,6 +271,20 @@ class GarnetNetwork : public Network
     statistics::Scalar  m_total_hops;
     statistics::Formula m_avg_hops;
 
+    statistics::Scalar m_multicast_packets;
+    statistics::Scalar m_multicast_flits_injected;
+    statistics::Scalar m_multicast_unicast_flits;
+    statistics::Formula m_multicast_flit_ratio;
+    statistics::Scalar m_multicast_copies_received;
+
+    statistics::Scalar m_flit_pool_allocs;
+    statistics::Scalar m_flit_pool_slab_allocs;
+
+    statistics::Scalar m_cycle_driven_cycles;
+    statistics::Scalar m_cycle_driven_switches;
+
+    statistics::Scalar m_routing_table_build_time;
+
     std::vector<std::vector<statistics::Scalar *>> m_data_traffic_distribution;
     std::vector<std::vector<statistics::Scalar *>> m_ctrl_traffic_distribution;
 
@@ -218,13 +292,39 @@ class GarnetNetwork : public Network
     GarnetNetwork(const GarnetNetwork& obj);
     GarnetNetwork& operator=(const GarnetNetwork& obj);
 
+    int getObjectRegion(ClockedObject *obj) const;
+    void partitionRegions();
+    void registerCycleKernel();
+
     std::vector<VNET_type > m_vnet_type;
     std::vector<Router *> m_routers;   // All Routers in Network
     std::vector<NetworkLink *> m_networklinks; // All flit links in the network
     std::vector<NetworkBridge *> m_networkbridges; // All network bridges
     std::vector<CreditLink *> m_creditlinks; // All credit links in the network
     std::vector<NetworkInterface *> m_nis;   // All NI's in Network
+    std::vector<PortDirection> m_port_dirn_names; // indexed by direction id
+    std::unordered_map<PortDirection, PortDirectionId> m_port_dirn_ids;
     int m_next_packet_id; // static vairable for packet id allocation
+    std::vector<std::unique_ptr<FlitPool>> m_flit_pools;
+    CycleKernel m_cycle_kernel;
+    // Only the NIs, all in region 0, update it
+    uint64_t m_packets_in_flight;
+    // Copies still in flight of each multicast packet, and the most hops
+    // a delivered copy took. NIs are all in region 0, so only its thread
+    // accesses them.
+    struct MulticastDelivery
+    {
+        int copies;
+        int max_hops;
+    };
+    std::unordered_map<int, MulticastDelivery> m_multicast_deliveries;
+    // Copies of all the multicast packets injected, one per destination,
+    // and those delivered. Unlike multicast_copies_received they are not
+    // reset with the stats, so they match whenever no copy is in flight.
+    uint64_t m_multicast_copies_sent;
+    uint64_t m_multicast_copies_delivered;
+    // Host seconds taken to build the routing tables
+    double m_routing_build_seconds;
 };
 
 inline std::ostream&
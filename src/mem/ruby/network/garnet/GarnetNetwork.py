@@ -35,6 +35,34 @@ from m5.objects.BasicRouter import BasicRouter
 from m5.objects.ClockedObject import ClockedObject
 
 
+# Switch allocation policy of the routers
+# separable: input-first separable allocator with round-robin arbiters
+# islip: iSLIP with sa_iterations iterations
+# wavefront: wavefront allocator with a rotating priority diagonal
+# matrix: input-first separable allocator with matrix (least recently
+#         served) arbiters
+class GarnetSAPolicy(ScopedEnum):
+    vals = ["separable", "islip", "wavefront", "matrix"]
+
+
+# Selection among the legal candidate outports of the 3D torus routing
+# random: uniformly at random
+# free_vcs: most idle VCs in the candidate's VC half
+# credits: most downstream credits in the candidate's VC half
+# regional: most credits at the candidate plus at the outport of the
+#           next router in the same direction
+class GarnetTorusSelection(ScopedEnum):
+    vals = ["random", "free_vcs", "credits", "regional"]
+
+
+# Classes the VCs of each vnet are split into. Routing functions restrict
+# the output VCs of a packet to a set of classes.
+# escape: deadlock-free escape channels (R2 channels of the 3D torus)
+# adaptive: fully adaptive channels (R1 channels of the 3D torus)
+class GarnetVcClass(ScopedEnum):
+    vals = ["escape", "adaptive"]
+
+
 class GarnetNetwork(RubyNetwork):
     type = "GarnetNetwork"
     cxx_header = "mem/ruby/network/garnet/GarnetNetwork.hh"
@@ -48,12 +76,72 @@ class GarnetNetwork(RubyNetwork):
     buffers_per_data_vc = Param.UInt32(4, "buffers per data virtual channel")
     buffers_per_ctrl_vc = Param.UInt32(1, "buffers per ctrl virtual channel")
     routing_algorithm = Param.Int(0, "0: Weight-based Table, 1: XY, 2: Custom")
+    torus_route_table_limit = Param.MemorySize(
+        "64MiB",
+        "max total size of the precomputed 3D torus route tables, "
+        "larger tori compute routes per flit",
+    )
+    torus_selection = Param.GarnetTorusSelection(
+        "random", "selection among the legal 3D torus candidate outports"
+    )
+    vc_classes = VectorParam.GarnetVcClass(
+        [],
+        "class of each VC of a vnet, VC i of every vnet is in class "
+        "vc_classes[i]; empty puts the first half of the VCs in the "
+        "adaptive class and the second half in the escape class",
+    )
     enable_fault_model = Param.Bool(False, "enable network fault model")
     fault_model = Param.FaultModel(NULL, "network fault model")
     garnet_deadlock_threshold = Param.UInt32(
         50000, "network-level deadlock threshold"
     )
+    random_seed = Param.UInt64(
+        1,
+        "seed of the random streams of the routers, each router draws "
+        "from its own stream derived from this seed and its id",
+    )
+    num_regions = Param.UInt32(
+        1,
+        "number of regions the routers are split into, region r gets the "
+        "routers with ids in [r * n / num_regions, (r + 1) * n / "
+        "num_regions), network interfaces are in region 0",
+    )
+    cycle_driven = Param.Bool(
+        False,
+        "run the routers, links and network interfaces from one per-cycle "
+        "loop while the network is dense",
+    )
+    cycle_driven_threshold = Param.Float(
+        0.25,
+        "wakeups per cycle, as a fraction of the routers, links and "
+        "network interfaces, above which the network runs cycle-driven",
+    )
+    multicast = Param.Bool(
+        False,
+        "send a multicast message as one packet that the routers "
+        "replicate, instead of one unicast packet per destination",
+    )
     wormhole = Param.Bool(False, "enable wormhole flow control")
+    virtual_cut_through = Param.Bool(
+        False,
+        "enable virtual cut-through flow control, head flits only "
+        "advance to a VC with room for the whole packet, and a VC takes "
+        "the next packet as soon as the previous tail flit was sent",
+    )
+    lookahead_routing = Param.Bool(
+        False,
+        "compute the route of head flits one hop ahead, "
+        "taking route computation off the router pipeline",
+    )
+    speculative_sa = Param.Bool(
+        False,
+        "allocate output VCs speculatively in parallel with the switch, "
+        "taking VC allocation off the router pipeline",
+    )
+    sa_policy = Param.GarnetSAPolicy(
+        "separable", "switch allocation policy of the routers"
+    )
+    sa_iterations = Param.UInt32(1, "number of iSLIP iterations")
 
 
 class GarnetNetworkInterface(ClockedObject):
@@ -86,3 +174,9 @@ class GarnetRouter(BasicRouter):
     width = Param.UInt32(
         Parent.ni_flit_size, "bit width supported by the router"
     )
+    sa_policy = Param.GarnetSAPolicy(
+        Parent.sa_policy, "switch allocation policy"
+    )
+    sa_iterations = Param.UInt32(
+        Parent.sa_iterations, "number of iSLIP iterations"
+    )
@@ -31,6 +31,9 @@
 
 #include "mem/ruby/network/garnet/InputUnit.hh"
 
+#include <algorithm>
+
+#include "base/bitfield.hh"
 #include "debug/RubyNetwork.hh"
 #include "mem/ruby/network/garnet/Credit.hh"
 #include "mem/ruby/network/garnet/Router.hh"
@@ -44,11 +47,15 @@ namespace ruby
 namespace garnet
 {
 
-InputUnit::InputUnit(int id, PortDirection direction, Router *router)
+InputUnit::InputUnit(int id, PortDirectionId direction, Router *router,
+                     int flits_per_credit)
   : Consumer(router), m_router(router), m_id(id), m_direction(direction),
-    m_vc_per_vnet(m_router->get_vc_per_vnet())
+    m_vc_per_vnet(m_router->get_vc_per_vnet()), m_occupied_vcs(0),
+    m_sa_ready_vcs(0), m_sa_waiting_vcs(0), m_sa_waiting_time(0)
 {
     const int m_num_vcs = m_router->get_num_vcs();
+    fatal_if(m_num_vcs > 64, "Router %d: SA supports at most 64 VCs per "
+             "port, got %d", m_router->get_id(), m_num_vcs);
     m_num_buffer_reads.resize(m_num_vcs/m_vc_per_vnet);
     m_num_buffer_writes.resize(m_num_vcs/m_vc_per_vnet);
     for (int i = 0; i < m_num_buffer_reads.size(); i++) {
@@ -56,10 +63,20 @@ InputUnit::InputUnit(int id, PortDirection direction, Router *router)
         m_num_buffer_writes[i] = 0;
     }
 
-    // Instantiating the virtual channels
+    // Instantiating the virtual channels, as deep as the flits the credits
+    // of the upstream router or NI let in. Behind a SerDes unit, a wide
+    // flit the upstream holds one credit for arrives as up to
+    // flits_per_credit narrow flits.
+    GarnetNetwork *net_ptr = m_router->get_net_ptr();
+    VcStateTable *table = &m_router->get_vc_table();
+    int vc_base = table->add_input_vcs(m_num_vcs);
     virtualChannels.reserve(m_num_vcs);
     for (int i=0; i < m_num_vcs; i++) {
-        virtualChannels.emplace_back();
+        int vnet = i / m_vc_per_vnet;
+        int depth = (net_ptr->get_vnet_type(vnet) == DATA_VNET_) ?
+            net_ptr->getBuffersPerDataVC() : net_ptr->getBuffersPerCtrlVC();
+        depth *= flits_per_credit;
+        virtualChannels.emplace_back(depth, table, vc_base + i);
     }
 }
 
@@ -67,7 +84,10 @@ InputUnit::InputUnit(int id, PortDirection direction, Router *router)
  * The InputUnit wakeup function reads the input flit from its input link.
  * Each flit arrives with an input VC.
  * For HEAD/HEAD_TAIL flits, performs route computation,
- * and updates route in the input VC.
+ * and updates route in the input VC. With lookahead routing, the route
+ * was already computed by the upstream router or NI and comes in the flit.
+ * With virtual cut-through, a head flit that arrives behind the previous
+ * packet in its VC is routed once it reaches the head of the VC.
  * The flit is buffered for (m_latency - 1) cycles in the input VC
  * and marked as valid for SwitchAllocation starting that cycle.
  *
@@ -78,7 +98,6 @@ InputUnit::wakeup()
 {
     flit *t_flit;
     bool wormhole = m_router->get_net_ptr()->isWormholeEnabled();
-    bool is_torus = (m_router->get_net_ptr()->getRoutingAlgorithm() == XYZ_);
     if (m_in_link->isReady(curTick())) {
 
         t_flit = m_in_link->consumeLink();
@@ -92,41 +111,27 @@ InputUnit::wakeup()
         if ((t_flit->get_type() == HEAD_) ||
             (t_flit->get_type() == HEAD_TAIL_)) {
 
-            if (!wormhole){
-                assert(virtualChannels[vc].get_state() == IDLE_);
-            }
-            set_vc_active(vc, curTick());
-
-            // Route computation for this vc
-            if (!is_torus) {
-                int outport = m_router->route_compute(t_flit->get_route(), m_id, m_direction);
-                if (!wormhole) {
-                    // Update output port in VC
-                    // All flits in this packet will use this output port
-                    // The output port field in the flit is updated after it wins SA
-                    grant_outport(vc, outport);
-                } else {
-                    // Update output port in flit
-                    // Different 1-flit packets in VC will use different output port
-                    // The output port in VC will be updated at the begining of SA
-                    t_flit->set_outport(outport);
-                }
+            if (!wormhole &&
+                virtualChannels[vc].get_state() == ACTIVE_) {
+                // Virtual cut-through: the upstream router sent this packet
+                // after the tail flit of the previous one, which is still
+                // in the VC. The packet is routed once it reaches the head
+                // of the VC, see next_packet().
+                assert(m_router->get_net_ptr()->isVirtualCutThrough());
+                assert(!virtualChannels[vc].isEmpty());
             } else {
-                // torus customed routing is not compatible with wormhole
-                assert(virtualChannels[vc].is_clear_outports() && virtualChannels[vc].get_first_half_vcs() == true);
-                std::set<std::pair<int, bool>> outports = m_router->torus_route_compute(t_flit->get_route(), m_id, m_direction);
-                virtualChannels[vc].set_outports(outports);
-                assert(virtualChannels[vc].get_outport() == -1 && virtualChannels[vc].get_outvc() == -1);
-                assert(virtualChannels[vc].get_outports().size() > 0 && virtualChannels[vc].get_outports().size() <= 4);
+                set_vc_active(vc, curTick());
+                route_packet(vc, t_flit);
             }
-
         } else {
             assert(virtualChannels[vc].get_state() == ACTIVE_);
         }
 
 
         // Buffer the flit
+        bool at_head = virtualChannels[vc].isEmpty();
         virtualChannels[vc].insertFlit(t_flit);
+        m_occupied_vcs |= (uint64_t)1 << vc;
 
         int vnet = vc/m_vc_per_vnet;
         // number of writes same as reads
@@ -150,6 +155,8 @@ InputUnit::wakeup()
             // Wakeup the router in that cycle to perform SA
             m_router->schedule_wakeup(Cycles(wait_time));
         }
+        if (at_head)
+            head_to_sa(vc, t_flit);
 
         if (m_in_link->isReady(curTick())) {
             m_router->schedule_wakeup(Cycles(1));
@@ -157,6 +164,112 @@ InputUnit::wakeup()
     }
 }
 
+// Route computation for the packet whose head flit t_flit is at the head
+// of vc
+void
+InputUnit::route_packet(int vc, flit *t_flit)
+{
+    bool wormhole = m_router->get_net_ptr()->isWormholeEnabled();
+    bool is_torus = (m_router->get_net_ptr()->getRoutingAlgorithm() == XYZ_);
+
+    if (t_flit->get_route().multicast) {
+        // Split the multicast packet into its branches here
+        m_router->multicast_route_compute(t_flit->get_route(), m_id,
+                                          m_direction, m_branches);
+        virtualChannels[vc].set_branches(m_branches);
+    } else if (!is_torus) {
+        int outport = t_flit->get_lookahead_outport();
+        if (outport == -1) {
+            outport = m_router->route_compute(t_flit->get_route(),
+                                              m_id, m_direction);
+        }
+        if (!wormhole) {
+            // Update output port in VC
+            // All flits in this packet will use this output port
+            // The output port field in the flit is updated after it wins SA
+            grant_outport(vc, outport);
+        } else {
+            // Update output port in flit
+            // Different 1-flit packets in VC will use different output port
+            // The output port in VC will be updated at the begining of SA
+            t_flit->set_outport(outport);
+        }
+    } else {
+        // torus customed routing is not compatible with wormhole
+        assert(virtualChannels[vc].is_clear_outports() &&
+               virtualChannels[vc].get_vc_classes() == ALL_VC_CLASSES_);
+        if (t_flit->get_lookahead_outports().empty()) {
+            virtualChannels[vc].set_outports(
+                m_router->torus_route_compute(t_flit->get_route(),
+                                              m_id, m_direction));
+        } else {
+            virtualChannels[vc].set_outports(
+                t_flit->get_lookahead_outports());
+        }
+        assert(virtualChannels[vc].get_outport() == -1 &&
+               virtualChannels[vc].get_outvc() == -1);
+        assert(virtualChannels[vc].get_outports().size() > 0 &&
+               virtualChannels[vc].get_outports().size() <= 4);
+    }
+
+    t_flit->clear_lookahead();
+}
+
+// t_flit reached the head of vc, and requests SA from the time of its SA
+// stage on
+void
+InputUnit::head_to_sa(int vc, flit *t_flit)
+{
+    assert(t_flit->get_stage().first == SA_);
+    Tick sa_time = t_flit->get_stage().second;
+    uint64_t vc_bit = (uint64_t)1 << vc;
+    if (sa_time <= curTick()) {
+        m_sa_ready_vcs |= vc_bit;
+    } else {
+        if (!m_sa_waiting_vcs || sa_time < m_sa_waiting_time)
+            m_sa_waiting_time = sa_time;
+        m_sa_waiting_vcs |= vc_bit;
+    }
+}
+
+// The waiting VCs whose head flit is in SA stage at time. Those that are
+// at the current time become ready.
+uint64_t
+InputUnit::sa_ready_waiting_vcs(Tick time)
+{
+    uint64_t ready = 0;
+    Tick next_time = MaxTick;
+    for (uint64_t vcs = m_sa_waiting_vcs; vcs; vcs &= vcs - 1) {
+        int vc = ctz64(vcs);
+        Tick sa_time = virtualChannels[vc].peekTopFlit()->get_stage().second;
+        if (sa_time <= time)
+            ready |= (uint64_t)1 << vc;
+        else
+            next_time = std::min(next_time, sa_time);
+    }
+
+    if (time <= curTick()) {
+        m_sa_ready_vcs |= ready;
+        m_sa_waiting_vcs &= ~ready;
+        m_sa_waiting_time = next_time;
+    }
+    return ready;
+}
+
+// Virtual cut-through: the tail flit of the packet in vc has left, and
+// the head flit of the next packet, which arrived behind it, is now at
+// the head of the VC
+void
+InputUnit::next_packet(int vc)
+{
+    flit *t_flit = virtualChannels[vc].peekTopFlit();
+    assert(t_flit->get_type() == HEAD_ || t_flit->get_type() == HEAD_TAIL_);
+
+    // The packet entered the VC when its head flit arrived
+    virtualChannels[vc].next_packet(t_flit->get_time());
+    route_packet(vc, t_flit);
+}
+
 // Send a credit back to upstream router for this VC.
 // Called by SwitchAllocator when the flit in this VC wins the Switch.
 void
@@ -164,9 +277,8 @@ InputUnit::increment_credit(int in_vc, bool free_signal, Tick curTime)
 {
     DPRINTF(RubyNetwork, "Router[%d]: Sending a credit vc:%d free:%d to %s\n",
     m_router->get_id(), in_vc, free_signal, m_credit_link->name());
-    Credit *t_credit = new Credit(in_vc, free_signal, curTime);
-    creditQueue.insert(t_credit);
-    m_credit_link->scheduleEventAbsolute(m_router->clockEdge(Cycles(1)));
+    creditQueue.insert(in_vc, free_signal, curTime);
+    m_credit_link->scheduleWakeupAbsolute(m_router->clockEdge(Cycles(1)));
 }
 
 bool
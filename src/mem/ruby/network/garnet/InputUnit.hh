@@ -37,6 +37,7 @@
 
 #include "mem/ruby/common/Consumer.hh"
 #include "mem/ruby/network/garnet/CommonTypes.hh"
+#include "mem/ruby/network/garnet/CreditBuffer.hh"
 #include "mem/ruby/network/garnet/CreditLink.hh"
 #include "mem/ruby/network/garnet/NetworkLink.hh"
 #include "mem/ruby/network/garnet/Router.hh"
@@ -55,13 +56,14 @@ namespace garnet
 class InputUnit : public Consumer
 {
   public:
-    InputUnit(int id, PortDirection direction, Router *router);
+    InputUnit(int id, PortDirectionId direction, Router *router,
+              int flits_per_credit = 1);
     ~InputUnit() = default;
 
     void wakeup();
     void print(std::ostream& out) const {};
 
-    inline PortDirection get_direction() { return m_direction; }
+    inline PortDirectionId get_direction() { return m_direction; }
 
     inline void
     set_vc_idle(int vc, Tick curTime)
@@ -75,6 +77,8 @@ class InputUnit : public Consumer
         virtualChannels[vc].set_active(curTime);
     }
 
+    void next_packet(int vc);
+
     inline void
     grant_outport(int vc, int outport)
     {
@@ -82,9 +86,9 @@ class InputUnit : public Consumer
     }
 
     inline void
-    grant_firsthalf(int vc, bool first_half)
+    grant_vc_classes(int vc, VcClassMask vc_classes)
     {
-        virtualChannels[vc].set_first_half_vcs(first_half);
+        virtualChannels[vc].set_vc_classes(vc_classes);
     }
 
     inline void
@@ -105,16 +109,52 @@ class InputUnit : public Consumer
         return virtualChannels[invc].get_outvc();
     }
 
-    std::set<std::pair<int, bool>>
+    inline const OutportCandidates &
     get_outports(int invc)
     {
         return virtualChannels[invc].get_outports();
     }
 
+    inline VcClassMask
+    get_vc_classes(int invc)
+    {
+        return virtualChannels[invc].get_vc_classes();
+    }
+
+    inline bool
+    has_branches(int invc)
+    {
+        return virtualChannels[invc].has_branches();
+    }
+
     inline bool
-    get_firsthalf(int invc)
+    is_last_branch(int invc)
+    {
+        return virtualChannels[invc].is_last_branch();
+    }
+
+    inline const RouteInfoPtr &
+    get_branch_route(int invc)
+    {
+        return virtualChannels[invc].get_branch_route();
+    }
+
+    inline const std::vector<MulticastBranch> &
+    get_branches(int invc)
     {
-        return virtualChannels[invc].get_first_half_vcs();
+        return virtualChannels[invc].get_branches();
+    }
+
+    inline void
+    grant_branch_outvc(int invc, int branch, int outvc)
+    {
+        virtualChannels[invc].set_branch_outvc(branch, outvc);
+    }
+
+    inline void
+    next_branch(int invc)
+    {
+        virtualChannels[invc].next_branch();
     }
 
 
@@ -135,7 +175,28 @@ class InputUnit : public Consumer
     inline flit*
     getTopFlit(int vc)
     {
-        return virtualChannels[vc].getTopFlit();
+        flit *t_flit = virtualChannels[vc].getTopFlit();
+        uint64_t vc_bit = (uint64_t)1 << vc;
+        m_sa_ready_vcs &= ~vc_bit;
+        m_sa_waiting_vcs &= ~vc_bit;
+        if (virtualChannels[vc].isEmpty())
+            m_occupied_vcs &= ~vc_bit;
+        else
+            head_to_sa(vc, virtualChannels[vc].peekTopFlit());
+        return t_flit;
+    }
+
+    // Bitmask of the VCs holding at least one flit
+    inline uint64_t get_occupied_vcs() { return m_occupied_vcs; }
+
+    // Bitmask of the VCs whose head flit is in SA stage at time, the
+    // VCs for which need_stage(vc, SA_, time) holds
+    inline uint64_t
+    get_sa_ready_vcs(Tick time)
+    {
+        if (m_sa_waiting_vcs && m_sa_waiting_time <= time)
+            return m_sa_ready_vcs | sa_ready_waiting_vcs(time);
+        return m_sa_ready_vcs;
     }
 
     inline bool
@@ -150,7 +211,9 @@ class InputUnit : public Consumer
         return virtualChannels[invc].isReady(curTime);
     }
 
-    flitBuffer* getCreditQueue() { return &creditQueue; }
+    inline bool isEmpty(int invc) { return virtualChannels[invc].isEmpty(); }
+
+    CreditBuffer* getCreditQueue() { return &creditQueue; }
 
     inline void
     set_in_link(NetworkLink *link)
@@ -159,6 +222,7 @@ class InputUnit : public Consumer
     }
 
     inline int get_inlink_id() { return m_in_link->get_id(); }
+    inline bool is_in_link_empty() { return m_in_link->isEmpty(); }
 
     inline void
     set_credit_link(CreditLink *credit_link)
@@ -177,16 +241,32 @@ class InputUnit : public Consumer
     void resetStats();
 
   private:
+    void route_packet(int vc, flit *t_flit);
+    void head_to_sa(int vc, flit *t_flit);
+    uint64_t sa_ready_waiting_vcs(Tick time);
+
     Router *m_router;
     int m_id;
-    PortDirection m_direction;
+    PortDirectionId m_direction;
     int m_vc_per_vnet;
     NetworkLink *m_in_link;
     CreditLink *m_credit_link;
-    flitBuffer creditQueue;
+    CreditBuffer creditQueue;
 
     // Input Virtual channels
     std::vector<VirtualChannel> virtualChannels;
+    uint64_t m_occupied_vcs;
+    // The VCs whose head flit is in SA stage, and those whose head flit
+    // only enters it after the router pipeline delay, the earliest at
+    // m_sa_waiting_time. Every buffered flit waits for SA, so a VC enters
+    // one of the masks when a flit reaches its head, and leaves it when
+    // that flit wins SA.
+    uint64_t m_sa_ready_vcs;
+    uint64_t m_sa_waiting_vcs;
+    Tick m_sa_waiting_time;
+
+    // Scratch space for the branches of multicast head flits
+    std::vector<MulticastBranch> m_branches;
 
     // Statistical variables
     std::vector<double> m_num_buffer_writes;
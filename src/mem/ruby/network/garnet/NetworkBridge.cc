@@ -34,6 +34,7 @@
 
 #include <cmath>
 
+#include "base/bitfield.hh"
 #include "debug/RubyNetwork.hh"
 #include "params/GarnetIntLink.hh"
 
@@ -58,11 +59,18 @@ NetworkBridge::NetworkBridge(const Params &p)
     lastScheduledAt = 0;
 
     nLink = p.link;
+    cLink = dynamic_cast<CreditLink *>(nLink);
     if (mType == enums::LINK_OBJECT) {
         nLink->setLinkConsumer(this);
-        setSourceQueue(nLink->getBuffer(), nLink);
+        if (cLink)
+            setSourceQueue(cLink->getCreditBuffer(), cLink);
+        else
+            setSourceQueue(nLink->getBuffer(), nLink);
     } else if (mType == enums::OBJECT_LINK) {
-        nLink->setSourceQueue(&linkBuffer, this);
+        if (cLink)
+            cLink->setSourceQueue(&creditBuffer, this);
+        else
+            nLink->setSourceQueue(&linkBuffer, this);
         setLinkConsumer(nLink);
     } else {
         // CDC type must be set
@@ -95,8 +103,10 @@ NetworkBridge::~NetworkBridge()
 {
 }
 
-void
-NetworkBridge::scheduleFlit(flit *t_flit, Cycles latency)
+// Time at which the consumer receives what is sent now with latency, at
+// most one transfer per cycle of the consumer
+Tick
+NetworkBridge::sendTime(Cycles latency)
 {
     Cycles totLatency = latency;
 
@@ -108,11 +118,17 @@ NetworkBridge::scheduleFlit(flit *t_flit, Cycles latency)
     Tick sendTime = link_consumer->getObject()->clockEdge(totLatency);
     Tick nextAvailTick = lastScheduledAt + link_consumer->getObject()->\
             cyclesToTicks(Cycles(1));
-    sendTime = std::max(nextAvailTick, sendTime);
+    return std::max(nextAvailTick, sendTime);
+}
+
+void
+NetworkBridge::scheduleFlit(flit *t_flit, Cycles latency)
+{
+    Tick sendTime = this->sendTime(latency);
     t_flit->set_time(sendTime);
     lastScheduledAt = sendTime;
     linkBuffer.insert(t_flit);
-    link_consumer->scheduleEventAbsolute(sendTime);
+    wakeupConsumer(sendTime);
 }
 
 void
@@ -146,16 +162,8 @@ NetworkBridge::flitisizeAndSend(flit *t_flit)
             // same message together
             int num_flits = 0;
             int flitPossible = 0;
-            if (t_flit->get_type() == CREDIT_) {
-                lenBuffer[vc]++;
-                assert(extraCredit[vc].front());
-                if (lenBuffer[vc] == extraCredit[vc].front()) {
-                    flitPossible = 1;
-                    extraCredit[vc].pop();
-                    lenBuffer[vc] = 0;
-                }
-            } else if (t_flit->get_type() == TAIL_ ||
-                       t_flit->get_type() == HEAD_TAIL_) {
+            if (t_flit->get_type() == TAIL_ ||
+                t_flit->get_type() == HEAD_TAIL_) {
                 // If its the end of packet, then send whatever
                 // is available.
                 int sizeAvail = (t_flit->msgSize - sizeSent[vc]);
@@ -190,7 +198,7 @@ NetworkBridge::flitisizeAndSend(flit *t_flit)
 
             // Inform the credit serializer about the number
             // of flits that were generated.
-            if (t_flit->get_type() != CREDIT_ && fl) {
+            if (fl) {
                 coBridge->neutralize(vc, num_flits);
             }
 
@@ -209,15 +217,8 @@ NetworkBridge::flitisizeAndSend(flit *t_flit)
                 cur_width, target_width, vc, t_flit->msgSize);
 
             int flitPossible = 0;
-            if (t_flit->get_type() == CREDIT_) {
-                // We store the deserialization ratio and then
-                // access it when serializing credits in the
-                // oppposite direction.
-                assert(extraCredit[vc].front());
-                flitPossible = extraCredit[vc].front();
-                extraCredit[vc].pop();
-            } else if (t_flit->get_type() == HEAD_ ||
-                    t_flit->get_type() == BODY_) {
+            if (t_flit->get_type() == HEAD_ ||
+                t_flit->get_type() == BODY_) {
                 int sizeAvail =
                     ((t_flit->get_id() + 1)*cur_width) - sizeSent[vc];
                 flitPossible = floor((float)sizeAvail/(float)target_width);
@@ -234,18 +235,14 @@ NetworkBridge::flitisizeAndSend(flit *t_flit)
             assert(flitPossible > 0);
 
             // Schedule all the flits
-            // num_flits could be zero for credits
             for (int i = 0; i < flitPossible; i++) {
-                // Ignore neutralized credits
                 flit *fl = t_flit->serialize(i, flitPossible, target_width);
                 scheduleFlit(fl, serDesLatency);
                 DPRINTF(RubyNetwork, "Serialized to flit[%d of %d parts]:"
                 " %s\n", i+1, flitPossible, *fl);
             }
 
-            if (t_flit->get_type() != CREDIT_) {
-                coBridge->neutralize(vc, flitPossible);
-            }
+            coBridge->neutralize(vc, flitPossible);
             // Delete this flit, new flit is sent in any case
             delete t_flit;
         }
@@ -255,9 +252,101 @@ NetworkBridge::flitisizeAndSend(flit *t_flit)
     // If only CDC is enabled schedule it
     scheduleFlit(t_flit, Cycles(0));
 }
+/*
+ * The credits ready in a cycle are converted together and sent as one
+ * transfer. The credit deserializer forwards a credit for a VC once it
+ * received one for each of the narrow flits that the co-bridge generated
+ * from a wide flit. The credit serializer sends one credit for each of the
+ * wide flits the co-bridge built from narrow ones, over consecutive
+ * cycles, and only the last credit of a VC carries its free signal.
+ */
+void
+NetworkBridge::sendCredits()
+{
+    // Deserialize only if the credits come from the narrow side
+    bool deserialize = false;
+    if (enSerDes) {
+        int target_width = bitWidth;
+        int cur_width = nLink->bitWidth;
+        if (mType == enums::OBJECT_LINK) {
+            target_width = nLink->bitWidth;
+            cur_width = bitWidth;
+        }
+        assert(target_width != cur_width);
+        deserialize = target_width > cur_width;
+    }
+
+    struct VcCredit
+    {
+        int vc;
+        bool is_free_signal;
+        // Number of cycles the credit is sent over
+        int parts;
+    };
+    std::vector<VcCredit> credits;
+    int max_parts = 0;
+    while (credit_srcQueue->isReady(curTick())) {
+        Credit t_credit = credit_srcQueue->getTopCredit();
+        DPRINTF(RubyNetwork, "Recieved credit %s\n", t_credit);
+
+        for (uint64_t vcs = t_credit.get_vcs(); vcs; vcs &= vcs - 1) {
+            int vc = ctz64(vcs);
+            bool is_free_signal = (t_credit.get_free_vcs() >> vc) & 1;
+            int parts = 1;
+            if (enSerDes && deserialize) {
+                lenBuffer[vc]++;
+                assert(!extraCredit[vc].empty());
+                if (lenBuffer[vc] != extraCredit[vc].front())
+                    continue;
+                extraCredit[vc].pop();
+                lenBuffer[vc] = 0;
+            } else if (enSerDes) {
+                // We stored the deserialization ratio and now
+                // access it when serializing credits in the
+                // oppposite direction.
+                assert(!extraCredit[vc].empty());
+                parts = extraCredit[vc].front();
+                extraCredit[vc].pop();
+            }
+
+            credits.push_back({vc, is_free_signal, parts});
+            max_parts = std::max(max_parts, parts);
+        }
+    }
+
+    if (credits.empty())
+        return;
+
+    Tick send_time = sendTime(enSerDes ? serDesLatency : Cycles(0));
+    Tick period = link_consumer->getObject()->cyclesToTicks(Cycles(1));
+    for (int i = 0; i < max_parts; i++) {
+        for (const VcCredit &credit : credits) {
+            if (i < credit.parts) {
+                creditBuffer.insert(credit.vc,
+                    (i + 1 == credit.parts) && credit.is_free_signal,
+                    send_time + i * period);
+            }
+        }
+        DPRINTF(RubyNetwork, "Sent credits [%d of %d parts] at %ld\n",
+                i + 1, max_parts, send_time + i * period);
+        wakeupConsumer(send_time + i * period);
+    }
+    lastScheduledAt = send_time + (max_parts - 1) * period;
+}
+
 void
 NetworkBridge::wakeup()
 {
+    if (cLink) {
+        sendCredits();
+
+        // Reschedule in case there is a waiting credit.
+        if (!credit_srcQueue->isEmpty()) {
+            scheduleWakeup(Cycles(1));
+        }
+        return;
+    }
+
     flit *t_flit;
 
     if (link_srcQueue->isReady(curTick())) {
@@ -268,7 +357,7 @@ NetworkBridge::wakeup()
 
     // Reschedule in case there is a waiting flit.
     if (!link_srcQueue->isEmpty()) {
-        scheduleEvent(Cycles(1));
+        scheduleWakeup(Cycles(1));
     }
 }
 
@@ -69,9 +69,12 @@ class NetworkBridge: public CreditLink
 
     void scheduleFlit(flit *t_flit, Cycles latency);
     void flitisizeAndSend(flit *t_flit);
+    void sendCredits();
     void setVcsPerVnet(uint32_t consumerVcs);
 
   protected:
+    Tick sendTime(Cycles latency);
+
     // Pointer to co-existing bridge
     // CreditBridge for Network Bridge and vice versa
     NetworkBridge *coBridge;
@@ -80,6 +83,8 @@ class NetworkBridge: public CreditLink
     // could be a source or destination
     // depending on mType
     NetworkLink *nLink;
+    // nLink if it is a credit link, whose credits this bridge converts
+    CreditLink *cLink;
 
     // CDC enable/disable
     bool enCdc;
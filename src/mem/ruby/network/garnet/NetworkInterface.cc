@@ -35,6 +35,7 @@
 #include <cassert>
 #include <cmath>
 
+#include "base/bitfield.hh"
 #include "base/cast.hh"
 #include "debug/RubyNetwork.hh"
 #include "mem/ruby/network/MessageBuffer.hh"
@@ -52,7 +53,7 @@ namespace garnet
 {
 
 NetworkInterface::NetworkInterface(const Params &p)
-  : ClockedObject(p), Consumer(this), m_id(p.id),
+  : ClockedObject(p), GarnetConsumer(this), m_id(p.id),
     m_virtual_networks(p.virt_nets), m_vc_per_vnet(0),
     m_vc_allocator(m_virtual_networks, 0),
     m_deadlock_threshold(p.garnet_deadlock_threshold),
@@ -147,12 +148,19 @@ NetworkInterface::dequeueCallback()
     // is now space to enqueue a stalled message. However, we cannot wake
     // on the same cycle as the dequeue. Schedule a wake at the soonest
     // possible time (next cycle).
-    scheduleEventAbsolute(clockEdge(Cycles(1)));
+    scheduleWakeupAbsolute(clockEdge(Cycles(1)));
 }
 
 void
 NetworkInterface::incrementStats(flit *t_flit)
 {
+    // A flit of a copy of a multicast packet
+    if (t_flit->get_route().branch_dest) {
+        if (t_flit->get_type() == TAIL_ || t_flit->get_type() == HEAD_TAIL_)
+            incrementMulticastStats(t_flit);
+        return;
+    }
+
     int vnet = t_flit->get_vnet();
 
     // Latency
@@ -174,7 +182,40 @@ NetworkInterface::incrementStats(flit *t_flit)
     }
 
     // Hops
-    m_net_ptr->increment_total_hops(t_flit->get_route().hops_traversed);
+    m_net_ptr->increment_total_hops(t_flit->get_hops_traversed());
+}
+
+// A multicast packet counts as one received packet, like the packet that
+// was injected, when the tail flit of its last copy arrives. Its flits are
+// counted with the latencies of that tail flit and the most hops any of
+// its copies took. Every copy counts in multicast_copies_received.
+void
+NetworkInterface::incrementMulticastStats(flit *t_flit)
+{
+    int hops;
+    if (!m_net_ptr->deliver_multicast_copy(t_flit->getPacketID(),
+                                           t_flit->get_hops_traversed(),
+                                           hops)) {
+        return;
+    }
+
+    int vnet = t_flit->get_vnet();
+    Tick network_delay =
+        t_flit->get_dequeue_time() -
+        t_flit->get_enqueue_time() - cyclesToTicks(Cycles(1));
+    Tick queueing_delay = t_flit->get_src_delay() +
+        (curTick() - t_flit->get_dequeue_time());
+
+    m_net_ptr->increment_received_packets(vnet);
+    m_net_ptr->increment_packet_network_latency(network_delay, vnet);
+    m_net_ptr->increment_packet_queueing_latency(queueing_delay, vnet);
+
+    for (int i = 0; i < t_flit->get_size(); i++) {
+        m_net_ptr->increment_received_flits(vnet);
+        m_net_ptr->increment_flit_network_latency(network_delay, vnet);
+        m_net_ptr->increment_flit_queueing_latency(queueing_delay, vnet);
+        m_net_ptr->increment_total_hops(hops);
+    }
 }
 
 /*
@@ -243,16 +284,15 @@ NetworkInterface::wakeup()
                 if (!iPort->messageEnqueuedThisCycle &&
                     outNode_ptr[vnet]->areNSlotsAvailable(1, curTime)) {
                     // Space is available. Enqueue to protocol buffer.
-                    outNode_ptr[vnet]->enqueue(t_flit->get_msg_ptr(), curTime,
+                    outNode_ptr[vnet]->enqueue(deliveredMsg(t_flit), curTime,
                                                cyclesToTicks(Cycles(1)));
 
                     // Simply send a credit back since we are not buffering
                     // this flit in the NI
-                    Credit *cFlit = new Credit(t_flit->get_vc(),
-                                               true, curTick());
-                    iPort->sendCredit(cFlit);
+                    iPort->sendCredit(t_flit->get_vc(), true, curTick());
                     // Update stats and delete flit pointer
                     incrementStats(t_flit);
+                    m_net_ptr->decrement_packets_in_flight();
                     delete t_flit;
                 } else {
                     // No space available- Place tail flit in stall queue and
@@ -267,11 +307,9 @@ NetworkInterface::wakeup()
                 }
             } else {
                 // Non-tail flit. Send back a credit but not VC free signal.
-                Credit *cFlit = new Credit(t_flit->get_vc(), false,
-                                               curTick());
                 // Simply send a credit back since we are not buffering
                 // this flit in the NI
-                iPort->sendCredit(cFlit);
+                iPort->sendCredit(t_flit->get_vc(), false, curTick());
 
                 // Update stats and delete flit pointer.
                 incrementStats(t_flit);
@@ -284,14 +322,15 @@ NetworkInterface::wakeup()
 
     for (auto &oPort: outPorts) {
         CreditLink *inCreditLink = oPort->inCreditLink();
-        if (inCreditLink->isReady(curTick())) {
-            Credit *t_credit = (Credit*) inCreditLink->consumeLink();
-            outVcState[t_credit->get_vc()].increment_credit();
-            if (t_credit->is_free_signal()) {
-                outVcState[t_credit->get_vc()].setState(IDLE_,
-                    curTick());
+        while (inCreditLink->isReady(curTick())) {
+            Credit t_credit = inCreditLink->consumeCredit();
+            for (uint64_t vcs = t_credit.get_vcs(); vcs; vcs &= vcs - 1) {
+                outVcState[ctz64(vcs)].increment_credit();
+            }
+            for (uint64_t vcs = t_credit.get_free_vcs(); vcs;
+                 vcs &= vcs - 1) {
+                outVcState[ctz64(vcs)].setState(IDLE_, curTick());
             }
-            delete t_credit;
         }
     }
 
@@ -303,10 +342,10 @@ NetworkInterface::wakeup()
     for (auto &iPort: inPorts) {
         if (iPort->outCreditQueue()->getSize() > 0) {
             DPRINTF(RubyNetwork, "Sending a credit %s via %s at %ld\n",
-            *(iPort->outCreditQueue()->peekTopFlit()),
+            iPort->outCreditQueue()->peekTopCredit(),
             iPort->outCreditLink()->name(), clockEdge(Cycles(1)));
             iPort->outCreditLink()->
-                scheduleEventAbsolute(clockEdge(Cycles(1)));
+                scheduleWakeupAbsolute(clockEdge(Cycles(1)));
         }
     }
     checkReschedule();
@@ -331,17 +370,16 @@ NetworkInterface::checkStallQueue()
                 // send back credits
                 if (outNode_ptr[vnet]->areNSlotsAvailable(1,
                     curTime)) {
-                    outNode_ptr[vnet]->enqueue(stallFlit->get_msg_ptr(),
+                    outNode_ptr[vnet]->enqueue(deliveredMsg(stallFlit),
                         curTime, cyclesToTicks(Cycles(1)));
 
                     // Send back a credit with free signal now that the
                     // VC is no longer stalled.
-                    Credit *cFlit = new Credit(stallFlit->get_vc(), true,
-                                                   curTick());
-                    iPort->sendCredit(cFlit);
+                    iPort->sendCredit(stallFlit->get_vc(), true, curTick());
 
                     // Update Stats
                     incrementStats(stallFlit);
+                    m_net_ptr->decrement_packets_in_flight();
 
                     // Flit can now safely be deleted and removed from stall
                     // queue
@@ -385,6 +423,38 @@ NetworkInterface::flitisizeMessage(MsgPtr msg_ptr, int vnet)
         m_net_ptr->MessageSizeType_to_int(net_msg_ptr->getMessageSize()),
         vnet, oPort->bitWidth());
 
+    int msg_size =
+        m_net_ptr->MessageSizeType_to_int(net_msg_ptr->getMessageSize());
+    Tick src_delay = curTick() - msg_ptr->getTime();
+
+    // With multicast, a message to several destinations is one packet
+    // that the routers replicate towards the destinations
+    if (m_net_ptr->isMulticastEnabled() && dest_nodes.size() > 1) {
+        int vc = calculateVC(vnet);
+        if (vc == -1) {
+            return false;
+        }
+
+        // The packet gets its own copy of the message, as a unicast
+        // packet does, which holds the destination set it is routed on
+        MsgPtr new_msg_ptr = msg_ptr->clone();
+
+        RouteInfo *route = new (m_net_ptr->getFlitPool(0)) RouteInfo();
+        route->vnet = vnet;
+        route->net_dest = &new_msg_ptr->getDestination();
+        route->src_ni = m_id;
+        route->src_router = oPort->routerID();
+        route->dest_ni = -1;
+        route->dest_router = -1;
+        route->multicast = true;
+
+        m_net_ptr->increment_multicast_flits(num_flits,
+                                             num_flits * dest_nodes.size());
+        enqueuePacket(new_msg_ptr, RouteInfoPtr(route), vc, num_flits,
+                      msg_size, src_delay, oPort);
+        return true;
+    }
+
     // loop to convert all multicast messages into unicast messages
     for (int ctr = 0; ctr < dest_nodes.size(); ctr++) {
 
@@ -399,62 +469,86 @@ NetworkInterface::flitisizeMessage(MsgPtr msg_ptr, int vnet)
 
         Message *new_net_msg_ptr = new_msg_ptr.get();
         if (dest_nodes.size() > 1) {
-            NetDest personal_dest;
-            for (int m = 0; m < (int) MachineType_NUM; m++) {
-                if ((destID >= MachineType_base_number((MachineType) m)) &&
-                    destID < MachineType_base_number((MachineType) (m+1))) {
-                    // calculating the NetDest associated with this destID
-                    personal_dest.clear();
-                    personal_dest.add((MachineID) {(MachineType) m, (destID -
-                        MachineType_base_number((MachineType) m))});
-                    new_net_msg_ptr->getDestination() = personal_dest;
-                    break;
-                }
-            }
+            // calculating the NetDest associated with this destID
+            NetDest personal_dest = m_net_ptr->getNodeDest(destID);
+            new_net_msg_ptr->getDestination() = personal_dest;
             net_msg_dest.removeNetDest(personal_dest);
             // removing the destination from the original message to reflect
             // that a message with this particular destination has been
             // flitisized and an output vc is acquired
             net_msg_ptr->getDestination().removeNetDest(personal_dest);
+            m_net_ptr->increment_multicast_flits(num_flits, num_flits);
         }
 
         // Embed Route into the flits
         // NetDest format is used by the routing table
         // Custom routing algorithms just need destID
 
-        RouteInfo route;
-        route.vnet = vnet;
-        route.net_dest = new_net_msg_ptr->getDestination();
-        route.src_ni = m_id;
-        route.src_router = oPort->routerID();
-        route.dest_ni = destID;
-        route.dest_router = m_net_ptr->get_router_id(destID, vnet);
-
-        // initialize hops_traversed to -1
-        // so that the first router increments it to 0
-        route.hops_traversed = -1;
-
-        m_net_ptr->increment_injected_packets(vnet);
-        m_net_ptr->update_traffic_distribution(route);
-        int packet_id = m_net_ptr->getNextPacketID();
-        for (int i = 0; i < num_flits; i++) {
-            m_net_ptr->increment_injected_flits(vnet);
-            flit *fl = new flit(packet_id,
-                i, vc, vnet, route, num_flits, new_msg_ptr,
-                m_net_ptr->MessageSizeType_to_int(
-                net_msg_ptr->getMessageSize()),
-                oPort->bitWidth(), curTick());
-
-            fl->set_src_delay(curTick() - msg_ptr->getTime());
-            niOutVcs[vc].insert(fl);
-        }
-
-        m_ni_out_vcs_enqueue_time[vc] = curTick();
-        outVcState[vc].setState(ACTIVE_, curTick());
+        // The route is shared by all flits of the packet
+        RouteInfo *route = new (m_net_ptr->getFlitPool(0)) RouteInfo();
+        route->vnet = vnet;
+        route->net_dest = &new_net_msg_ptr->getDestination();
+        route->src_ni = m_id;
+        route->src_router = oPort->routerID();
+        route->dest_ni = destID;
+        route->dest_router = m_net_ptr->get_router_id(destID, vnet);
+
+        enqueuePacket(new_msg_ptr, RouteInfoPtr(route), vc, num_flits,
+                      msg_size, src_delay, oPort);
     }
     return true ;
 }
 
+// Turn a packet into flits in output VC vc
+void
+NetworkInterface::enqueuePacket(const MsgPtr &msg_ptr,
+                                const RouteInfoPtr &route, int vc,
+                                int num_flits, int msg_size, Tick src_delay,
+                                OutputPort *oPort)
+{
+    int vnet = route->vnet;
+    m_net_ptr->increment_injected_packets(vnet);
+    m_net_ptr->update_traffic_distribution(*route);
+    m_net_ptr->increment_packets_in_flight(
+        route->multicast ? route->net_dest->count() : 1);
+    int packet_id = m_net_ptr->getNextPacketID();
+    if (route->multicast) {
+        m_net_ptr->add_multicast_packet(packet_id,
+                                        route->net_dest->count());
+    }
+    for (int i = 0; i < num_flits; i++) {
+        m_net_ptr->increment_injected_flits(vnet);
+        flit *fl = new (m_net_ptr->getFlitPool(0)) flit(packet_id,
+            i, vc, vnet, route, num_flits, msg_ptr, msg_size,
+            oPort->bitWidth(), curTick());
+
+        fl->set_src_delay(src_delay);
+        if (i == 0 && m_net_ptr->isLookaheadRouting()) {
+            // The first router gets the packet already routed
+            oPort->outNetLink()->lookaheadRoute(fl, m_rng);
+        }
+        niOutVcs[vc].insert(fl);
+    }
+
+    m_ni_out_vcs_enqueue_time[vc] = curTick();
+    outVcState[vc].setState(ACTIVE_, curTick());
+}
+
+// Message a tail flit delivers to the protocol. Every copy of a multicast
+// packet gets a copy of the message addressed to its own destination.
+MsgPtr
+NetworkInterface::deliveredMsg(flit *t_flit)
+{
+    const RouteInfo &route = t_flit->get_route();
+    if (!route.branch_dest)
+        return t_flit->get_msg_ptr();
+
+    assert(!route.multicast);
+    MsgPtr msg_ptr = t_flit->get_msg_ptr()->clone();
+    msg_ptr->getDestination() = *route.branch_dest;
+    return msg_ptr;
+}
+
 // Looking for a free output vc
 int
 NetworkInterface::calculateVC(int vnet)
@@ -596,7 +690,7 @@ NetworkInterface::scheduleFlit(flit *t_flit)
         oPort->outNetLink()->name(), clockEdge(Cycles(1)),
         *t_flit, *(t_flit->get_msg_ptr()));
         oPort->outFlitQueue()->insert(t_flit);
-        oPort->outNetLink()->scheduleEventAbsolute(clockEdge(Cycles(1)));
+        oPort->outNetLink()->scheduleWakeupAbsolute(clockEdge(Cycles(1)));
         return;
     }
 
@@ -630,14 +724,14 @@ NetworkInterface::checkReschedule()
         }
 
         while (it->isReady(clockEdge())) { // Is there a message waiting
-            scheduleEvent(Cycles(1));
+            scheduleWakeup(Cycles(1));
             return;
         }
     }
 
     for (auto& ni_out_vc : niOutVcs) {
         if (ni_out_vc.isReady(clockEdge(Cycles(1)))) {
-            scheduleEvent(Cycles(1));
+            scheduleWakeup(Cycles(1));
             return;
         }
     }
@@ -648,7 +742,7 @@ NetworkInterface::checkReschedule()
     for (auto &iPort : inPorts) {
         NetworkLink *inNetLink = iPort->inNetLink();
         if (inNetLink->isReady(curTick())) {
-            scheduleEvent(Cycles(1));
+            scheduleWakeup(Cycles(1));
             return;
         }
     }
@@ -656,7 +750,7 @@ NetworkInterface::checkReschedule()
     for (auto &oPort : outPorts) {
         CreditLink *inCreditLink = oPort->inCreditLink();
         if (inCreditLink->isReady(curTick())) {
-            scheduleEvent(Cycles(1));
+            scheduleWakeup(Cycles(1));
             return;
         }
     }
@@ -36,13 +36,14 @@
 #include <iostream>
 #include <vector>
 
-#include "mem/ruby/common/Consumer.hh"
 #include "mem/ruby/network/garnet/CommonTypes.hh"
 #include "mem/ruby/network/garnet/Credit.hh"
 #include "mem/ruby/network/garnet/CreditLink.hh"
+#include "mem/ruby/network/garnet/CycleKernel.hh"
 #include "mem/ruby/network/garnet/GarnetNetwork.hh"
 #include "mem/ruby/network/garnet/NetworkLink.hh"
 #include "mem/ruby/network/garnet/OutVcState.hh"
+#include "mem/ruby/network/garnet/RandomStream.hh"
 #include "mem/ruby/slicc_interface/Message.hh"
 #include "params/GarnetNetworkInterface.hh"
 
@@ -59,7 +60,7 @@ namespace garnet
 
 class flitBuffer;
 
-class NetworkInterface : public ClockedObject, public Consumer
+class NetworkInterface : public ClockedObject, public GarnetConsumer
 {
   public:
     typedef GarnetNetworkInterfaceParams Params;
@@ -77,7 +78,14 @@ class NetworkInterface : public ClockedObject, public Consumer
 
     void print(std::ostream& out) const;
     int get_vnet(int vc);
-    void init_net_ptr(GarnetNetwork *net_ptr) { m_net_ptr = net_ptr; }
+    void
+    init_net_ptr(GarnetNetwork *net_ptr)
+    {
+        m_net_ptr = net_ptr;
+        // The streams of the NIs follow those of the routers
+        m_rng.seed(net_ptr->getRandomSeed(),
+                   net_ptr->getNumRouters() + m_id);
+    }
 
     bool functionalRead(Packet *pkt, WriteMask &mask);
     uint32_t functionalWrite(Packet *);
@@ -194,14 +202,14 @@ class NetworkInterface : public ClockedObject, public Consumer
           InputPort(NetworkLink *inLink, CreditLink *creditLink)
           {
               _vnets = inLink->mVnets;
-              _outCreditQueue = new flitBuffer();
+              _outCreditQueue = new CreditBuffer();
 
               _inNetLink = inLink;
               _outCreditLink = creditLink;
               _bitWidth = inLink->bitWidth;
           }
 
-          flitBuffer *
+          CreditBuffer *
           outCreditQueue()
           {
               return _outCreditQueue;
@@ -234,9 +242,9 @@ class NetworkInterface : public ClockedObject, public Consumer
 
           }
 
-          void sendCredit(Credit *cFlit)
+          void sendCredit(int vc, bool is_free_signal, Tick curTime)
           {
-              _outCreditQueue->insert(cFlit);
+              _outCreditQueue->insert(vc, is_free_signal, curTime);
           }
 
           uint32_t bitWidth()
@@ -260,7 +268,7 @@ class NetworkInterface : public ClockedObject, public Consumer
           bool messageEnqueuedThisCycle;
       private:
           std::vector<int> _vnets;
-          flitBuffer *_outCreditQueue;
+          CreditBuffer *_outCreditQueue;
 
           NetworkLink *_inNetLink;
           CreditLink *_outCreditLink;
@@ -278,6 +286,9 @@ class NetworkInterface : public ClockedObject, public Consumer
     std::vector<InputPort *> inPorts;
     int m_deadlock_threshold;
     std::vector<OutVcState> outVcState;
+    // Source of the random choices of lookahead routing at the first
+    // router
+    RandomStream m_rng;
 
     std::vector<int> m_stall_count;
 
@@ -295,6 +306,10 @@ class NetworkInterface : public ClockedObject, public Consumer
 
     void checkStallQueue();
     bool flitisizeMessage(MsgPtr msg_ptr, int vnet);
+    void enqueuePacket(const MsgPtr &msg_ptr, const RouteInfoPtr &route,
+                       int vc, int num_flits, int msg_size, Tick src_delay,
+                       OutputPort *oPort);
+    MsgPtr deliveredMsg(flit *t_flit);
     int calculateVC(int vnet);
 
 
@@ -303,6 +318,7 @@ class NetworkInterface : public ClockedObject, public Consumer
     void checkReschedule();
 
     void incrementStats(flit *t_flit);
+    void incrementMulticastStats(flit *t_flit);
 
     InputPort *getInportForVnet(int vnet);
     OutputPort *getOutportForVnet(int vnet);
@@ -35,6 +35,7 @@
 #include "base/trace.hh"
 #include "debug/RubyNetwork.hh"
 #include "mem/ruby/network/garnet/CreditLink.hh"
+#include "mem/ruby/network/garnet/Router.hh"
 
 namespace gem5
 {
@@ -46,11 +47,14 @@ namespace garnet
 {
 
 NetworkLink::NetworkLink(const Params &p)
-    : ClockedObject(p), Consumer(this), m_id(p.link_id),
+    : ClockedObject(p), GarnetConsumer(this), m_id(p.link_id),
       m_type(NUM_LINK_TYPES_),
-      m_latency(p.link_latency), m_link_utilized(0),
+      m_latency(p.link_latency), src_object(nullptr),
+      m_cross_region(false), m_link_utilized(0),
       m_virt_nets(p.virt_nets), linkBuffer(),
-      link_consumer(nullptr), link_srcQueue(nullptr)
+      link_consumer(nullptr), m_consumer_activity(nullptr),
+      m_consumer_activity_bit(0), link_srcQueue(nullptr),
+      m_next_router(nullptr), m_next_inport(-1)
 {
     int num_vnets = (p.supported_vnets).size();
     mVnets.resize(num_vnets);
@@ -61,11 +65,77 @@ NetworkLink::NetworkLink(const Params &p)
 }
 
 void
-NetworkLink::setLinkConsumer(Consumer *consumer)
+NetworkLink::setLinkConsumer(GarnetConsumer *consumer)
 {
     link_consumer = consumer;
 }
 
+// Ports beyond the width of the mask are not tracked, their consumer
+// visits them on every wakeup
+void
+NetworkLink::setConsumerActivity(uint64_t *activity, int port)
+{
+    m_consumer_activity = activity;
+    m_consumer_activity_bit = (port < 64) ? (uint64_t)1 << port : 0;
+}
+
+void
+NetworkLink::setNextRouter(Router *router, int inport)
+{
+    m_next_router = router;
+    m_next_inport = inport;
+}
+
+// Compute the route of a head flit at the router this link feeds, so that
+// it arrives there with its output port(s) known. Links that feed a
+// network interface or a bridge have no such router, and the route is
+// then left to the next router. The random choices of the route are
+// drawn from rng, the stream of the router or NI sending the flit.
+void
+NetworkLink::lookaheadRoute(flit *t_flit, RandomStream &rng)
+{
+    if (m_next_router)
+        m_next_router->lookahead_route_compute(t_flit, m_next_inport, rng);
+}
+
+// Make this link the boundary between two regions of the network. The
+// consumer may run on another thread, so nothing is read from the router
+// it feeds: head flits are routed there on arrival, and regional torus
+// selection falls back to local estimates.
+void
+NetworkLink::setCrossRegion()
+{
+    m_cross_region = true;
+    m_next_router = nullptr;
+    m_next_inport = -1;
+}
+
+// The wakeup ticks of a consumer belong to its event queue. Across
+// regions, the wakeup is handed over as an event on that queue, which is
+// safe since the link latency is at least the simulation quantum.
+void
+NetworkLink::wakeupConsumer(Tick when)
+{
+    if (!m_cross_region) {
+        if (m_consumer_activity)
+            *m_consumer_activity |= m_consumer_activity_bit;
+        link_consumer->scheduleWakeupAbsolute(when);
+        return;
+    }
+
+    Consumer *consumer = link_consumer;
+    uint64_t *activity = m_consumer_activity;
+    uint64_t activity_bit = m_consumer_activity_bit;
+    auto *wakeup_event = new EventFunctionWrapper(
+        [consumer, activity, activity_bit, when]{
+            if (activity)
+                *activity |= activity_bit;
+            consumer->scheduleEventAbsolute(when);
+        },
+        name() + ".remoteWakeup", true, Event::Default_Pri - 1);
+    consumer->getObject()->eventQueue()->schedule(wakeup_event, when);
+}
+
 void
 NetworkLink::setVcsPerVnet(uint32_t consumerVcs)
 {
@@ -98,14 +168,19 @@ NetworkLink::wakeup()
                 (mVnets.size() == 0));
         }
         t_flit->set_time(clockEdge(m_latency));
-        linkBuffer.insert(t_flit);
-        link_consumer->scheduleEventAbsolute(clockEdge(m_latency));
+        if (m_cross_region) {
+            std::lock_guard<std::mutex> lock(m_region_mutex);
+            linkBuffer.insert(t_flit);
+        } else {
+            linkBuffer.insert(t_flit);
+        }
+        wakeupConsumer(clockEdge(m_latency));
         m_link_utilized++;
         m_vc_load[t_flit->get_vc()]++;
     }
 
     if (!link_srcQueue->isEmpty()) {
-        scheduleEvent(Cycles(1));
+        scheduleWakeup(Cycles(1));
     }
 }
 
@@ -34,10 +34,11 @@
 #define __MEM_RUBY_NETWORK_GARNET_0_NETWORKLINK_HH__
 
 #include <iostream>
+#include <mutex>
 #include <vector>
 
-#include "mem/ruby/common/Consumer.hh"
 #include "mem/ruby/network/garnet/CommonTypes.hh"
+#include "mem/ruby/network/garnet/CycleKernel.hh"
 #include "mem/ruby/network/garnet/flitBuffer.hh"
 #include "params/NetworkLink.hh"
 #include "sim/clocked_object.hh"
@@ -52,16 +53,27 @@ namespace garnet
 {
 
 class GarnetNetwork;
+class RandomStream;
+class Router;
 
-class NetworkLink : public ClockedObject, public Consumer
+class NetworkLink : public ClockedObject, public GarnetConsumer
 {
   public:
     typedef NetworkLinkParams Params;
     NetworkLink(const Params &p);
     ~NetworkLink() = default;
 
-    void setLinkConsumer(Consumer *consumer);
+    void setLinkConsumer(GarnetConsumer *consumer);
+    void setConsumerActivity(uint64_t *activity, int port);
+    GarnetConsumer *getLinkConsumer() { return link_consumer; }
+    void setNextRouter(Router *router, int inport);
+    Router *getNextRouter() { return m_next_router; }
+    void lookaheadRoute(flit *t_flit, RandomStream &rng);
     void setSourceQueue(flitBuffer *src_queue, ClockedObject *srcClockObject);
+    ClockedObject *getSourceObject() { return src_object; }
+    Cycles getLatency() const { return m_latency; }
+    void setCrossRegion();
+    bool isCrossRegion() const { return m_cross_region; }
     virtual void setVcsPerVnet(uint32_t consumerVcs);
     void setType(link_type type) { m_type = type; }
     link_type getType() { return m_type; }
@@ -75,11 +87,38 @@ class NetworkLink : public ClockedObject, public Consumer
 
     inline bool isReady(Tick curTime)
     {
+        if (!m_cross_region)
+            return linkBuffer.isReady(curTime);
+        std::lock_guard<std::mutex> lock(m_region_mutex);
         return linkBuffer.isReady(curTime);
     }
 
-    inline flit* peekLink() { return linkBuffer.peekTopFlit(); }
-    inline flit* consumeLink() { return linkBuffer.getTopFlit(); }
+    inline bool
+    isEmpty()
+    {
+        if (!m_cross_region)
+            return linkBuffer.isEmpty();
+        std::lock_guard<std::mutex> lock(m_region_mutex);
+        return linkBuffer.isEmpty();
+    }
+
+    inline flit*
+    peekLink()
+    {
+        if (!m_cross_region)
+            return linkBuffer.peekTopFlit();
+        std::lock_guard<std::mutex> lock(m_region_mutex);
+        return linkBuffer.peekTopFlit();
+    }
+
+    inline flit*
+    consumeLink()
+    {
+        if (!m_cross_region)
+            return linkBuffer.getTopFlit();
+        std::lock_guard<std::mutex> lock(m_region_mutex);
+        return linkBuffer.getTopFlit();
+    }
 
     bool functionalRead(Packet *pkt, WriteMask &mask);
     uint32_t functionalWrite(Packet *);
@@ -95,16 +134,32 @@ class NetworkLink : public ClockedObject, public Consumer
 
     ClockedObject *src_object;
 
+  protected:
+    void wakeupConsumer(Tick when);
+
+    // Links between two regions of the network are written and read from
+    // the event queues (and threads) of two different regions
+    bool m_cross_region;
+    std::mutex m_region_mutex;
+
     // Statistical variables
     unsigned int m_link_utilized;
     std::vector<unsigned int> m_vc_load;
 
-  protected:
     uint32_t m_virt_nets;
     flitBuffer linkBuffer;
-    Consumer *link_consumer;
+    GarnetConsumer *link_consumer;
+    // Port bit set in a mask of the consumer whenever it is woken up for
+    // an arrival on this link
+    uint64_t *m_consumer_activity;
+    uint64_t m_consumer_activity_bit;
     flitBuffer *link_srcQueue;
 
+    // Router (and its input port) directly fed by this link, used by
+    // lookahead routing and regional congestion estimates
+    Router *m_next_router;
+    int m_next_inport;
+
 };
 
 } // namespace garnet
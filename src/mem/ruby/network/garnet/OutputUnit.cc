@@ -31,6 +31,7 @@
 
 #include "mem/ruby/network/garnet/OutputUnit.hh"
 
+#include "base/bitfield.hh"
 #include "debug/RubyNetwork.hh"
 #include "mem/ruby/network/garnet/Credit.hh"
 #include "mem/ruby/network/garnet/CreditLink.hh"
@@ -46,16 +47,32 @@ namespace ruby
 namespace garnet
 {
 
-OutputUnit::OutputUnit(int id, PortDirection direction, Router *router,
+OutputUnit::OutputUnit(int id, PortDirectionId direction, Router *router,
   uint32_t consumerVcs)
   : Consumer(router), m_router(router), m_id(id), m_direction(direction),
     m_vc_per_vnet(consumerVcs)
 {
+    // Each VC starts with as many credits as its buffer at the next router
+    GarnetNetwork *net_ptr = m_router->get_net_ptr();
     const int m_num_vcs = consumerVcs * m_router->get_num_vnets();
-    outVcState.reserve(m_num_vcs);
+    std::vector<int> max_credits(m_num_vcs);
     for (int i = 0; i < m_num_vcs; i++) {
-        outVcState.emplace_back(i, m_router->get_net_ptr(), consumerVcs);
+        int vnet = i / consumerVcs;
+        max_credits[i] = (net_ptr->get_vnet_type(vnet) == DATA_VNET_) ?
+            net_ptr->getBuffersPerDataVC() : net_ptr->getBuffersPerCtrlVC();
+        assert(max_credits[i] >= 1);
     }
+    m_vc_table = &m_router->get_vc_table();
+    m_vc_base = m_vc_table->add_output_vcs(max_credits);
+
+    fatal_if(m_num_vcs > 64, "Router %d: at most 64 VCs per output port, "
+             "got %d", m_router->get_id(), m_num_vcs);
+    m_idle_vcs = mask(m_num_vcs);
+    m_credit_vcs = mask(m_num_vcs);
+    m_virtual_cut_through = net_ptr->isVirtualCutThrough();
+    m_reusable_vcs = 0;
+    for (VcClassMask c = 0; c <= ALL_VC_CLASSES_; c++)
+        m_vc_class_vcs[c] = net_ptr->getVcClassVcs(m_vc_per_vnet, c);
 }
 
 void
@@ -64,10 +81,14 @@ OutputUnit::decrement_credit(int out_vc)
     DPRINTF(RubyNetwork, "Router %d OutputUnit %s decrementing credit:%d for "
             "outvc %d at time: %lld for %s\n", m_router->get_id(),
             m_router->getPortDirectionName(get_direction()),
-            outVcState[out_vc].get_credit_count(),
+            get_credit_count(out_vc),
             out_vc, m_router->curCycle(), m_credit_link->name());
 
-    outVcState[out_vc].decrement_credit();
+    int &credits = m_vc_table->out_credits[m_vc_base + out_vc];
+    credits--;
+    assert(credits >= 0);
+    if (credits == 0)
+        m_credit_vcs &= ~((uint64_t)1 << out_vc);
 }
 
 void
@@ -76,64 +97,81 @@ OutputUnit::increment_credit(int out_vc)
     DPRINTF(RubyNetwork, "Router %d OutputUnit %s incrementing credit:%d for "
             "outvc %d at time: %lld from:%s\n", m_router->get_id(),
             m_router->getPortDirectionName(get_direction()),
-            outVcState[out_vc].get_credit_count(),
+            get_credit_count(out_vc),
             out_vc, m_router->curCycle(), m_credit_link->name());
 
-    outVcState[out_vc].increment_credit();
+    int &credits = m_vc_table->out_credits[m_vc_base + out_vc];
+    credits++;
+    assert(credits <= m_vc_table->out_max_credits[m_vc_base + out_vc]);
+    m_credit_vcs |= (uint64_t)1 << out_vc;
 }
 
 // Check if the output VC (i.e., input VC at next router)
 // has free credits (i..e, buffer slots).
-// This is tracked by OutVcState
+// This is tracked by out_credits in the VcStateTable of the router
 bool
 OutputUnit::has_credit(int out_vc)
 {
-    assert(outVcState[out_vc].isInState(ACTIVE_, curTick()));
-    return outVcState[out_vc].has_credit();
+    assert(is_vc_in_state(out_vc, ACTIVE_, curTick()));
+    return get_credit_count(out_vc) > 0;
 }
 
 
-// Check if the output port (i.e., input port at next router) has free VCs.
-bool
-OutputUnit::has_free_vc(int vnet)
+// VCs of vnet among vcs (a mask of idle VCs or of VCs with credits) that
+// are in one of vc_classes, shifted down to bit 0
+uint64_t
+OutputUnit::vnet_vcs(uint64_t vcs, int vnet, VcClassMask vc_classes)
+{
+    return (vcs >> (vnet * m_vc_per_vnet)) & m_vc_class_vcs[vc_classes];
+}
+
+// VCs of vnet in one of vc_classes that can take a packet and have at
+// least min_credits credits, shifted down to bit 0: the idle VCs and,
+// with virtual cut-through, the VCs the previous packet was sent on.
+// Idle VCs have all their credits and each VC has at least one buffer,
+// so only virtual cut-through (min_credits = packet size) checks credits.
+uint64_t
+OutputUnit::free_vcs(int vnet, VcClassMask vc_classes, int min_credits)
 {
+    uint64_t vcs = vnet_vcs(m_idle_vcs, vnet, vc_classes);
+    if (m_virtual_cut_through)
+        vcs |= vnet_vcs(m_reusable_vcs, vnet, vc_classes);
+    else if (min_credits <= 1)
+        return vcs;
+
     int vc_base = vnet*m_vc_per_vnet;
-    for (int vc = vc_base; vc < vc_base + m_vc_per_vnet; vc++) {
-        if (is_vc_idle(vc, curTick()))
-            return true;
+    for (uint64_t left = vcs; left; left &= left - 1) {
+        int vc = ctz64(left);
+        if (get_credit_count(vc_base + vc) < min_credits)
+            vcs &= ~((uint64_t)1 << vc);
     }
-
-    return false;
+    return vcs;
 }
 
-// Check if the output port (i.e., input port at next router) has free VCs.
-// Only check the first half.
-// Only used in 3D Torus customered routing
+// Check if the output port (i.e., input port at next router) has free VCs
+// in one of vc_classes, with room for min_credits flits.
 bool
-OutputUnit::first_has_free_vc(int vnet)
+OutputUnit::has_free_vc(int vnet, VcClassMask vc_classes, int min_credits)
 {
-    int vc_base = vnet*m_vc_per_vnet;
-    for (int vc = vc_base; vc < vc_base + (m_vc_per_vnet / 2); vc++) {
-        if (is_vc_idle(vc, curTick()))
-            return true;
-    }
+    return free_vcs(vnet, vc_classes, min_credits) != 0;
+}
 
-    return false;
+// Number of idle VCs and total credits of the VCs of vnet in one of
+// vc_classes
+int
+OutputUnit::count_free_vcs(int vnet, VcClassMask vc_classes)
+{
+    return popCount(vnet_vcs(m_idle_vcs, vnet, vc_classes));
 }
 
-// Check if the output port (i.e., input port at next router) has free VCs.
-// Only check the second half.
-// Only used in 3D Torus customered routing
-bool
-OutputUnit::second_has_free_vc(int vnet)
+int
+OutputUnit::count_credits(int vnet, VcClassMask vc_classes)
 {
     int vc_base = vnet*m_vc_per_vnet;
-    for (int vc = vc_base + (m_vc_per_vnet / 2); vc < vc_base + m_vc_per_vnet; vc++) {
-        if (is_vc_idle(vc, curTick()))
-            return true;
-    }
-
-    return false;
+    int credits = 0;
+    for (uint64_t vcs = m_vc_class_vcs[vc_classes]; vcs; vcs &= vcs - 1)
+        credits += get_credit_count(vc_base + ctz64(vcs));
+    return credits;
 }
 
 // Check if the output port has vc with credits (used in wormhole case)
@@ -141,103 +179,103 @@ OutputUnit::second_has_free_vc(int vnet)
 bool
 OutputUnit::has_vc_with_credits(int vnet)
 {
-    int vc_base = vnet * m_vc_per_vnet;
-    for (int vc = vc_base; vc < vc_base + m_vc_per_vnet; vc++) {
-        if (outVcState[vc].has_credit()) {
-            return true;
-        }
-    }
-    return false;
+    return vnet_vcs(m_credit_vcs, vnet, ALL_VC_CLASSES_) != 0;
 }
 
-
-// Assign a free output VC to the winner of Switch Allocation
+// Assign a free output VC in one of vc_classes, with room for min_credits
+// flits, to the winner of Switch Allocation. An idle VC is preferred to
+// queueing behind the previous packet of a VC.
 int
-OutputUnit::select_free_vc(int vnet)
+OutputUnit::select_free_vc(int vnet, VcClassMask vc_classes,
+                           int min_credits)
 {
-    int vc_base = vnet*m_vc_per_vnet;
-    for (int vc = vc_base; vc < vc_base + m_vc_per_vnet; vc++) {
-        if (is_vc_idle(vc, curTick())) {
-            outVcState[vc].setState(ACTIVE_, curTick());
-            return vc;
-        }
-    }
-
-    return -1;
+    uint64_t vcs = free_vcs(vnet, vc_classes, min_credits);
+    if (!vcs)
+        return -1;
+
+    uint64_t idle_vcs = vcs & vnet_vcs(m_idle_vcs, vnet, vc_classes);
+    int vc = vnet * m_vc_per_vnet + ctz64(idle_vcs ? idle_vcs : vcs);
+    set_vc_state(ACTIVE_, vc, curTick());
+    m_reusable_vcs &= ~((uint64_t)1 << vc);
+    m_vc_table->out_packets[m_vc_base + vc]++;
+    return vc;
 }
 
-// Assign a free output VC to the winner of Switch Allocation
-// Only check the first half.
-// Only used in 3D Torus customered routing
-int
-OutputUnit::first_select_free_vc(int vnet)
+// Give back an output VC select_free_vc() assigned in this cycle
+void
+OutputUnit::release_vc(int vc)
 {
-    int vc_base = vnet*m_vc_per_vnet;
-    for (int vc = vc_base; vc < vc_base + (m_vc_per_vnet / 2); vc++) {
-        if (is_vc_idle(vc, curTick())) {
-            outVcState[vc].setState(ACTIVE_, curTick());
-            return vc;
-        }
-    }
-
-    return -1;
+    int &packets = m_vc_table->out_packets[m_vc_base + vc];
+    assert(packets > 0);
+    if (--packets == 0)
+        set_vc_state(IDLE_, vc, curTick());
+    else
+        m_reusable_vcs |= (uint64_t)1 << vc;
 }
 
-// Assign a free output VC to the winner of Switch Allocation
-// Only check the second half.
-// Only used in 3D Torus customered routing
-int
-OutputUnit::second_select_free_vc(int vnet)
+// The tail flit of the packet on output VC vc was sent. With virtual
+// cut-through the VC can take the next packet right away.
+void
+OutputUnit::tail_sent(int vc)
 {
-    int vc_base = vnet*m_vc_per_vnet;
-    for (int vc = vc_base + (m_vc_per_vnet / 2); vc < vc_base + m_vc_per_vnet; vc++) {
-        if (is_vc_idle(vc, curTick())) {
-            outVcState[vc].setState(ACTIVE_, curTick());
-            return vc;
-        }
-    }
-
-    return -1;
+    if (m_virtual_cut_through)
+        m_reusable_vcs |= (uint64_t)1 << vc;
 }
 
 // Assign an output VC with credits to the winner of Switch Allocation (used in wormhole)
 int
-OutputUnit::select_vc_with_credits(int vnet) {
-    int vc_base = vnet * m_vc_per_vnet;
-    for (int vc = vc_base; vc < vc_base + m_vc_per_vnet; vc++) {
-        if(outVcState[vc].has_credit()) {
-            return vc;
-        }
-    }
-    return -1;
+OutputUnit::select_vc_with_credits(int vnet)
+{
+    uint64_t vcs = vnet_vcs(m_credit_vcs, vnet, ALL_VC_CLASSES_);
+    if (!vcs)
+        return -1;
+    return vnet * m_vc_per_vnet + ctz64(vcs);
 }
 
 /*
- * The wakeup function of the OutputUnit reads the credit signal from the
- * downstream router for the output VC (i.e., input VC at downstream router).
- * It increments the credit count in the appropriate output VC state.
- * If the credit carries is_free_signal as true,
- * the output VC is marked IDLE.
+ * The wakeup function of the OutputUnit reads the credits that arrived
+ * from the downstream router for the output VCs (i.e., input VCs at the
+ * downstream router) in this cycle.
+ * Each credit word increments the credit count of every output VC it
+ * credits. An output VC whose is_free_signal it carries had a packet
+ * leave the downstream router, and is marked IDLE once no other packet
+ * sent on it is left there.
  */
 
 void
 OutputUnit::wakeup()
 {
-    if (m_credit_link->isReady(curTick())) {
-        Credit *t_credit = (Credit*) m_credit_link->consumeLink();
-        increment_credit(t_credit->get_vc());
-
-        if (t_credit->is_free_signal())
-            set_vc_state(IDLE_, t_credit->get_vc(), curTick());
-
-        delete t_credit;
-
-        if (m_credit_link->isReady(curTick())) {
-            scheduleEvent(Cycles(1));
+    while (m_credit_link->isReady(curTick())) {
+        Credit t_credit = m_credit_link->consumeCredit();
+        for (uint64_t vcs = t_credit.get_vcs(); vcs; vcs &= vcs - 1)
+            increment_credit(ctz64(vcs));
+
+        for (uint64_t vcs = t_credit.get_free_vcs(); vcs; vcs &= vcs - 1) {
+            int vc = ctz64(vcs);
+            int &packets = m_vc_table->out_packets[m_vc_base + vc];
+            assert(packets > 0);
+            if (--packets == 0) {
+                set_vc_state(IDLE_, vc, curTick());
+                m_reusable_vcs &= ~((uint64_t)1 << vc);
+            }
         }
     }
 }
 
+// Compute the route of a head flit at the next router, with the random
+// stream of this router
+void
+OutputUnit::lookahead_route(flit *t_flit)
+{
+    m_out_link->lookaheadRoute(t_flit, m_router->get_rng());
+}
+
+bool
+OutputUnit::is_credit_link_empty()
+{
+    return m_credit_link->isEmpty();
+}
+
 flitBuffer*
 OutputUnit::getOutQueue()
 {
@@ -260,7 +298,7 @@ void
 OutputUnit::insert_flit(flit *t_flit)
 {
     outBuffer.insert(t_flit);
-    m_out_link->scheduleEventAbsolute(m_router->clockEdge(Cycles(1)));
+    m_out_link->scheduleWakeupAbsolute(m_router->clockEdge(Cycles(1)));
 }
 
 bool
@@ -39,7 +39,7 @@
 #include "mem/ruby/common/Consumer.hh"
 #include "mem/ruby/network/garnet/CommonTypes.hh"
 #include "mem/ruby/network/garnet/NetworkLink.hh"
-#include "mem/ruby/network/garnet/OutVcState.hh"
+#include "mem/ruby/network/garnet/VcStateTable.hh"
 
 namespace gem5
 {
@@ -56,7 +56,7 @@ class Router;
 class OutputUnit : public Consumer
 {
   public:
-    OutputUnit(int id, PortDirection direction, Router *router,
+    OutputUnit(int id, PortDirectionId direction, Router *router,
                uint32_t consumerVcs);
     ~OutputUnit() = default;
     void set_out_link(NetworkLink *link);
@@ -67,21 +67,23 @@ class OutputUnit : public Consumer
     void decrement_credit(int out_vc);
     void increment_credit(int out_vc);
     bool has_credit(int out_vc);
-    bool has_free_vc(int vnet);
-    bool first_has_free_vc(int vnet);
-    bool second_has_free_vc(int vnet);
+    bool has_free_vc(int vnet, VcClassMask vc_classes = ALL_VC_CLASSES_,
+                     int min_credits = 1);
     bool has_vc_with_credits(int vnet);
-    int select_free_vc(int vnet);
-    int first_select_free_vc(int vnet);
-    int second_select_free_vc(int vnet);
+    int select_free_vc(int vnet, VcClassMask vc_classes = ALL_VC_CLASSES_,
+                       int min_credits = 1);
     int select_vc_with_credits(int vnet);
+    void release_vc(int vc);
+    void tail_sent(int vc);
+    int count_free_vcs(int vnet, VcClassMask vc_classes);
+    int count_credits(int vnet, VcClassMask vc_classes);
 
-    inline PortDirection get_direction() { return m_direction; }
+    inline PortDirectionId get_direction() { return m_direction; }
 
     int
     get_credit_count(int vc)
     {
-        return outVcState[vc].get_credit_count();
+        return m_vc_table->out_credits[m_vc_base + vc];
     }
 
     inline int
@@ -90,16 +92,44 @@ class OutputUnit : public Consumer
         return m_out_link->get_id();
     }
 
+    bool is_credit_link_empty();
+
+    void lookahead_route(flit *t_flit);
+
+    // Router directly downstream of this port, nullptr for an NI or a
+    // bridge
+    inline Router *
+    get_next_router()
+    {
+        return m_out_link->getNextRouter();
+    }
+
+    // VC states are only changed for the current tick, so a VC in the
+    // idle mask is idle at any tick it can be allocated at
     inline void
     set_vc_state(VC_state_type state, int vc, Tick curTime)
     {
-      outVcState[vc].setState(state, curTime);
+        assert(curTime <= curTick());
+        m_vc_table->out_state[m_vc_base + vc] = state;
+        m_vc_table->out_state_time[m_vc_base + vc] = curTime;
+        if (state == IDLE_)
+            m_idle_vcs |= (uint64_t)1 << vc;
+        else
+            m_idle_vcs &= ~((uint64_t)1 << vc);
+    }
+
+    inline bool
+    is_vc_in_state(int vc, VC_state_type state, Tick curTime)
+    {
+        return m_vc_table->out_state[m_vc_base + vc] == state &&
+               curTime >= m_vc_table->out_state_time[m_vc_base + vc];
     }
 
     inline bool
     is_vc_idle(int vc, Tick curTime)
     {
-        return (outVcState[vc].isInState(IDLE_, curTime));
+        assert(curTime >= m_vc_table->out_state_time[m_vc_base + vc]);
+        return m_idle_vcs & ((uint64_t)1 << vc);
     }
 
     void insert_flit(flit *t_flit);
@@ -114,17 +144,31 @@ class OutputUnit : public Consumer
     uint32_t functionalWrite(Packet *pkt);
 
   private:
+    uint64_t vnet_vcs(uint64_t vcs, int vnet, VcClassMask vc_classes);
+    uint64_t free_vcs(int vnet, VcClassMask vc_classes, int min_credits);
+
     Router *m_router;
     GEM5_CLASS_VAR_USED int m_id;
-    PortDirection m_direction;
+    PortDirectionId m_direction;
     int m_vc_per_vnet;
     NetworkLink *m_out_link;
     CreditLink *m_credit_link;
 
     // This is for the network link to consume
     flitBuffer outBuffer;
-    // vc state of downstream router
-    std::vector<OutVcState> outVcState;
+    // vc state of downstream router, entries [m_vc_base, m_vc_base +
+    // number of VCs) of the VC state table of the router
+    VcStateTable *m_vc_table;
+    int m_vc_base;
+    // Idle VCs and VCs with credits, bit vc for VC vc
+    uint64_t m_idle_vcs;
+    uint64_t m_credit_vcs;
+    // Virtual cut-through: active VCs the tail flit of the last packet
+    // was sent on, which take the next packet once they have room for it
+    bool m_virtual_cut_through;
+    uint64_t m_reusable_vcs;
+    // VCs of a vnet in each set of VC classes, indexed by VcClassMask
+    uint64_t m_vc_class_vcs[ALL_VC_CLASSES_ + 1];
 };
 
 } // namespace garnet
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2026 The gem5 contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __MEM_RUBY_NETWORK_GARNET_0_RANDOMSTREAM_HH__
+#define __MEM_RUBY_NETWORK_GARNET_0_RANDOMSTREAM_HH__
+
+#include <cassert>
+#include <cstdint>
+
+namespace gem5
+{
+
+namespace ruby
+{
+
+namespace garnet
+{
+
+// Counter-based random number stream. The n-th number of a stream is a
+// hash (the SplitMix64 finalizer) of the stream key and n, so it only
+// depends on the seed, the stream id and how many numbers the stream
+// has produced, not on any other user of randomness in the simulator.
+class RandomStream
+{
+  public:
+    RandomStream() : m_key(0), m_counter(0) {}
+
+    void
+    seed(uint64_t seed, uint64_t stream)
+    {
+        m_key = mix(seed ^ mix(stream + GOLDEN_GAMMA));
+        m_counter = 0;
+    }
+
+    uint64_t
+    next()
+    {
+        m_counter++;
+        return mix(m_key + m_counter * GOLDEN_GAMMA);
+    }
+
+    // Uniform integer in [0, n)
+    int
+    random(int n)
+    {
+        assert(n > 0);
+        return next() % n;
+    }
+
+  private:
+    static const uint64_t GOLDEN_GAMMA = 0x9e3779b97f4a7c15ULL;
+
+    static uint64_t
+    mix(uint64_t z)
+    {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t m_key;
+    uint64_t m_counter;
+};
+
+} // namespace garnet
+} // namespace ruby
+} // namespace gem5
+
+#endif // __MEM_RUBY_NETWORK_GARNET_0_RANDOMSTREAM_HH__
@@ -32,6 +32,7 @@
 
 #include "mem/ruby/network/garnet/Router.hh"
 
+#include "base/bitfield.hh"
 #include "debug/RubyNetwork.hh"
 #include "mem/ruby/network/garnet/CreditLink.hh"
 #include "mem/ruby/network/garnet/GarnetNetwork.hh"
@@ -49,11 +50,13 @@ namespace garnet
 {
 
 Router::Router(const Params &p)
-  : BasicRouter(p), Consumer(this), m_latency(p.latency),
+  : BasicRouter(p), GarnetConsumer(this), m_latency(p.latency),
+    m_pipe_stages(p.latency),
     m_virtual_networks(p.virt_nets), m_vc_per_vnet(p.vcs_per_vnet),
     m_num_vcs(m_virtual_networks * m_vc_per_vnet), m_bit_width(p.width),
-    m_network_ptr(nullptr), routingUnit(this), switchAllocator(this),
-    crossbarSwitch(this)
+    m_sa_policy(p.sa_policy), m_sa_iterations(p.sa_iterations),
+    m_network_ptr(nullptr), m_pending_inports(0), m_pending_outports(0),
+    routingUnit(this), switchAllocator(this), crossbarSwitch(this)
 {
     m_input_unit.clear();
     m_output_unit.clear();
@@ -64,6 +67,28 @@ Router::init()
 {
     BasicRouter::init();
 
+    m_rng.seed(m_network_ptr->getRandomSeed(), m_id);
+
+    fatal_if(m_network_ptr->getRoutingAlgorithm() == XYZ_ &&
+             get_num_outports() > OutportCandidates::MAX_OUTPORTS,
+             "Router %d has %d outports, 3D torus routing supports at most "
+             "%d.", m_id, get_num_outports(),
+             OutportCandidates::MAX_OUTPORTS);
+
+    // Lookahead routing moves route computation, and speculative SA moves
+    // VC allocation, in parallel with other stages of the pipeline.
+    int saved_stages = (m_network_ptr->isLookaheadRouting() ? 1 : 0) +
+                       (m_network_ptr->isSpeculativeSA() ? 1 : 0);
+    fatal_if(saved_stages >= m_latency, "Router %d has %d pipeline stages, "
+             "lookahead routing and speculative SA each need one more "
+             "stage to remove.", m_id, (int)m_latency);
+    m_pipe_stages = m_latency - Cycles(saved_stages);
+
+    // The pending port masks only cover 64 ports. Larger routers (e.g.,
+    // the crossbar of a large system) visit all ports on every wakeup.
+    m_activity_masked = (get_num_inports() <= 64 &&
+                         get_num_outports() <= 64);
+
     switchAllocator.init();
     crossbarSwitch.init();
 }
@@ -75,8 +100,19 @@ Router::wakeup()
     assert(clockEdge() == curTick());
 
     // check for incoming flits
-    for (int inport = 0; inport < m_input_unit.size(); inport++) {
-        m_input_unit[inport]->wakeup();
+    // A port stays pending while its link has flits in flight
+    if (m_activity_masked) {
+        for (uint64_t inports = m_pending_inports; inports;
+             inports &= inports - 1) {
+            int inport = ctz64(inports);
+            m_input_unit[inport]->wakeup();
+            if (m_input_unit[inport]->is_in_link_empty())
+                m_pending_inports &= ~((uint64_t)1 << inport);
+        }
+    } else {
+        for (int inport = 0; inport < m_input_unit.size(); inport++) {
+            m_input_unit[inport]->wakeup();
+        }
     }
 
     // check for incoming credits
@@ -85,31 +121,57 @@ Router::wakeup()
     //     credit traversal (1-cycle) + SA (1-cycle) + Link Traversal (1-cycle)
     // if we want the credit update to take place after SA, this loop should
     // be moved after the SA request
-    for (int outport = 0; outport < m_output_unit.size(); outport++) {
-        m_output_unit[outport]->wakeup();
+    if (m_activity_masked) {
+        for (uint64_t outports = m_pending_outports; outports;
+             outports &= outports - 1) {
+            int outport = ctz64(outports);
+            m_output_unit[outport]->wakeup();
+            if (m_output_unit[outport]->is_credit_link_empty())
+                m_pending_outports &= ~((uint64_t)1 << outport);
+        }
+    } else {
+        for (int outport = 0; outport < m_output_unit.size(); outport++) {
+            m_output_unit[outport]->wakeup();
+        }
     }
 
-    // Switch Allocation
-    switchAllocator.wakeup();
+    // Switch Allocation, only needed while some input VC holds a flit
+    if (has_buffered_flits())
+        switchAllocator.wakeup();
 
     // Switch Traversal
-    crossbarSwitch.wakeup();
+    if (crossbarSwitch.has_flits())
+        crossbarSwitch.wakeup();
+}
+
+bool
+Router::has_buffered_flits()
+{
+    for (auto &input_unit : m_input_unit) {
+        if (input_unit->get_occupied_vcs())
+            return true;
+    }
+    return false;
 }
 
 void
-Router::addInPort(PortDirection inport_dirn,
-                  NetworkLink *in_link, CreditLink *credit_link)
+Router::addInPort(PortDirectionId inport_dirn,
+                  NetworkLink *in_link, CreditLink *credit_link,
+                  int flits_per_credit)
 {
     fatal_if(in_link->bitWidth != m_bit_width, "Widths of link %s(%d)does"
             " not match that of Router%d(%d). Consider inserting SerDes "
             "Units.", in_link->name(), in_link->bitWidth, m_id, m_bit_width);
 
     int port_num = m_input_unit.size();
-    InputUnit *input_unit = new InputUnit(port_num, inport_dirn, this);
+    InputUnit *input_unit = new InputUnit(port_num, inport_dirn, this,
+                                          flits_per_credit);
 
     input_unit->set_in_link(in_link);
     input_unit->set_credit_link(credit_link);
     in_link->setLinkConsumer(this);
+    in_link->setConsumerActivity(&m_pending_inports, port_num);
+    in_link->setNextRouter(this, port_num);
     in_link->setVcsPerVnet(get_vc_per_vnet());
     credit_link->setSourceQueue(input_unit->getCreditQueue(), this);
     credit_link->setVcsPerVnet(get_vc_per_vnet());
@@ -120,7 +182,7 @@ Router::addInPort(PortDirection inport_dirn,
 }
 
 void
-Router::addOutPort(PortDirection outport_dirn,
+Router::addOutPort(PortDirectionId outport_dirn,
                    NetworkLink *out_link,
                    std::vector<NetDest>& routing_table_entry, int link_weight,
                    CreditLink *credit_link, uint32_t consumerVcs)
@@ -135,6 +197,7 @@ Router::addOutPort(PortDirection outport_dirn,
     output_unit->set_out_link(out_link);
     output_unit->set_credit_link(credit_link);
     credit_link->setLinkConsumer(this);
+    credit_link->setConsumerActivity(&m_pending_outports, port_num);
     credit_link->setVcsPerVnet(consumerVcs);
     out_link->setSourceQueue(output_unit->getOutQueue(), this);
     out_link->setVcsPerVnet(consumerVcs);
@@ -146,28 +209,54 @@ Router::addOutPort(PortDirection outport_dirn,
     routingUnit.addOutDirection(outport_dirn, port_num);
 }
 
-PortDirection
+PortDirectionId
 Router::getOutportDirection(int outport)
 {
     return m_output_unit[outport]->get_direction();
 }
 
-PortDirection
+PortDirectionId
 Router::getInportDirection(int inport)
 {
     return m_input_unit[inport]->get_direction();
 }
 
 int
-Router::route_compute(RouteInfo route, int inport, PortDirection inport_dirn)
+Router::route_compute(const RouteInfo &route, int inport,
+                      PortDirectionId inport_dirn)
+{
+    return routingUnit.outportCompute(route, inport, inport_dirn, m_rng);
+}
+
+OutportCandidates
+Router::torus_route_compute(const RouteInfo &route, int inport,
+                            PortDirectionId inport_dirn)
 {
-    return routingUnit.outportCompute(route, inport, inport_dirn);
+    return routingUnit.outportComputeXYZ(route, inport, inport_dirn, m_rng);
 }
 
-std::set<std::pair<int, bool>>
-Router::torus_route_compute(RouteInfo route, int inport, PortDirection inport_dirn)
+// Route computation for a head flit that will enter this router through
+// inport, done while the flit is still one hop upstream. It runs in the
+// event of the upstream router or NI, so it only reads the routing state
+// of this router and draws its random choices from rng, the stream of
+// the upstream router or NI.
+void
+Router::lookahead_route_compute(flit *t_flit, int inport, RandomStream &rng)
 {
-    return routingUnit.outportComputeXYZ(route, inport, inport_dirn);
+    // Multicast packets are split at the router itself
+    if (t_flit->get_route().multicast)
+        return;
+
+    PortDirectionId inport_dirn = getInportDirection(inport);
+    if (m_network_ptr->getRoutingAlgorithm() == XYZ_) {
+        t_flit->set_lookahead_outports(
+            routingUnit.outportComputeXYZ(t_flit->get_route(), inport,
+                                          inport_dirn, rng));
+    } else {
+        t_flit->set_lookahead_outport(
+            routingUnit.outportCompute(t_flit->get_route(), inport,
+                                       inport_dirn, rng));
+    }
 }
 
 void
@@ -180,17 +269,13 @@ void
 Router::schedule_wakeup(Cycles time)
 {
     // wake up after time cycles
-    scheduleEvent(time);
+    scheduleWakeup(time);
 }
 
 std::string
-Router::getPortDirectionName(PortDirection direction)
+Router::getPortDirectionName(PortDirectionId direction)
 {
-    // PortDirection is actually a string
-    // If not, then this function should add a switch
-    // statement to convert direction to a string
-    // that can be printed out
-    return direction;
+    return m_network_ptr->getPortDirectionName(direction);
 }
 
 void
@@ -222,6 +307,36 @@ Router::regStats()
         .name(name() + ".sw_output_arbiter_activity")
         .flags(statistics::nozero)
     ;
+
+    // Each input port with a request counts one input arbitration and
+    // each grant one output arbitration, for all the SA policies.
+    m_sa_matching_efficiency
+        .name(name() + ".sa_matching_efficiency")
+        .flags(statistics::nozero)
+    ;
+    m_sa_matching_efficiency =
+        m_sw_output_arbiter_activity / m_sw_input_arbiter_activity;
+
+    m_sa_failed_speculations
+        .name(name() + ".sa_failed_speculations")
+        .flags(statistics::nozero)
+    ;
+
+    const char *channel_names[NUM_CHANNEL_TYPES_] = {
+        "R1xp", "R2xp", "R1xn", "R2xn", "R1yp", "R2yp", "R1yn", "R2yn",
+        "R1zp", "R2zp", "R1zn", "R2zn"};
+    m_torus_channel_selections
+        .init(NUM_CHANNEL_TYPES_)
+        .name(name() + ".torus_channel_selections")
+        .flags(statistics::nozero | statistics::oneline)
+    ;
+    for (int i = 0; i < NUM_CHANNEL_TYPES_; i++)
+        m_torus_channel_selections.subname(i, channel_names[i]);
+
+    m_multicast_replications
+        .name(name() + ".multicast_replications")
+        .flags(statistics::nozero)
+    ;
 }
 
 void
@@ -237,6 +352,13 @@ Router::collateStats()
     m_sw_input_arbiter_activity = switchAllocator.get_input_arbiter_activity();
     m_sw_output_arbiter_activity =
         switchAllocator.get_output_arbiter_activity();
+    m_sa_failed_speculations = switchAllocator.get_failed_speculations();
+    for (int i = 0; i < NUM_CHANNEL_TYPES_; i++) {
+        m_torus_channel_selections[i] =
+            switchAllocator.get_torus_channel_selections(i);
+    }
+    m_multicast_replications =
+        switchAllocator.get_multicast_replications();
     m_crossbar_activity = crossbarSwitch.get_crossbar_activity();
 }
 
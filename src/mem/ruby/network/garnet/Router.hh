@@ -36,14 +36,16 @@
 #include <memory>
 #include <vector>
 
-#include "mem/ruby/common/Consumer.hh"
 #include "mem/ruby/common/NetDest.hh"
 #include "mem/ruby/network/BasicRouter.hh"
 #include "mem/ruby/network/garnet/CommonTypes.hh"
 #include "mem/ruby/network/garnet/CrossbarSwitch.hh"
+#include "mem/ruby/network/garnet/CycleKernel.hh"
 #include "mem/ruby/network/garnet/GarnetNetwork.hh"
+#include "mem/ruby/network/garnet/RandomStream.hh"
 #include "mem/ruby/network/garnet/RoutingUnit.hh"
 #include "mem/ruby/network/garnet/SwitchAllocator.hh"
+#include "mem/ruby/network/garnet/VcStateTable.hh"
 #include "mem/ruby/network/garnet/flit.hh"
 #include "params/GarnetRouter.hh"
 
@@ -63,7 +65,7 @@ class CreditLink;
 class InputUnit;
 class OutputUnit;
 
-class Router : public BasicRouter, public Consumer
+class Router : public BasicRouter, public GarnetConsumer
 {
   public:
     typedef GarnetRouterParams Params;
@@ -75,17 +77,19 @@ class Router : public BasicRouter, public Consumer
     void print(std::ostream& out) const {};
 
     void init();
-    void addInPort(PortDirection inport_dirn, NetworkLink *link,
-                   CreditLink *credit_link);
-    void addOutPort(PortDirection outport_dirn, NetworkLink *link,
+    void addInPort(PortDirectionId inport_dirn, NetworkLink *link,
+                   CreditLink *credit_link, int flits_per_credit = 1);
+    void addOutPort(PortDirectionId outport_dirn, NetworkLink *link,
                     std::vector<NetDest>& routing_table_entry,
                     int link_weight, CreditLink *credit_link,
                     uint32_t consumerVcs);
 
-    Cycles get_pipe_stages(){ return m_latency; }
+    Cycles get_pipe_stages(){ return m_pipe_stages; }
     uint32_t get_num_vcs()       { return m_num_vcs; }
     uint32_t get_num_vnets()     { return m_virtual_networks; }
     uint32_t get_vc_per_vnet()   { return m_vc_per_vnet; }
+    GarnetSAPolicy get_sa_policy()  { return m_sa_policy; }
+    uint32_t get_sa_iterations()    { return m_sa_iterations; }
     int get_num_inports()   { return m_input_unit.size(); }
     int get_num_outports()  { return m_output_unit.size(); }
     int get_id()            { return m_id; }
@@ -97,6 +101,19 @@ class Router : public BasicRouter, public Consumer
 
     GarnetNetwork* get_net_ptr()                    { return m_network_ptr; }
 
+    // Pool of the region of this router
+    FlitPool &
+    get_flit_pool()
+    {
+        return m_network_ptr->getFlitPool(
+            m_network_ptr->getRouterRegion(m_id));
+    }
+
+    // Source of every random choice made for this router
+    RandomStream &get_rng()                         { return m_rng; }
+
+    VcStateTable &get_vc_table()                    { return m_vc_table; }
+
     InputUnit*
     getInputUnit(unsigned port)
     {
@@ -113,15 +130,43 @@ class Router : public BasicRouter, public Consumer
 
     int getBitWidth() { return m_bit_width; }
 
-    PortDirection getOutportDirection(int outport);
-    PortDirection getInportDirection(int inport);
-
-    int route_compute(RouteInfo route, int inport, PortDirection direction);
-    std::set<std::pair<int, bool>> torus_route_compute(RouteInfo route, int inport, PortDirection direction);
+    PortDirectionId getOutportDirection(int outport);
+    int
+    get_outport_of_direction(PortDirectionId direction)
+    {
+        return routingUnit.getOutportOfDirection(direction);
+    }
+    PortDirectionId getInportDirection(int inport);
+
+    int route_compute(const RouteInfo &route, int inport,
+                      PortDirectionId direction);
+    void lookahead_route_compute(flit *t_flit, int inport,
+                                 RandomStream &rng);
+    void
+    multicast_route_compute(const RouteInfo &route, int inport,
+                            PortDirectionId direction,
+                            std::vector<MulticastBranch> &branches)
+    {
+        routingUnit.outportComputeMulticast(route, inport, direction,
+                                            branches);
+    }
+    OutportCandidates torus_route_compute(const RouteInfo &route, int inport,
+                                          PortDirectionId direction);
+    void
+    init_dest_table()
+    {
+        routingUnit.initDestTable();
+    }
+    void
+    init_torus_routing(bool build_table)
+    {
+        routingUnit.initTorusRouting(build_table);
+    }
     void grant_switch(int inport, flit *t_flit);
+    bool has_buffered_flits();
     void schedule_wakeup(Cycles time);
 
-    std::string getPortDirectionName(PortDirection direction);
+    std::string getPortDirectionName(PortDirectionId direction);
     void printFaultVector(std::ostream& out);
     void printAggregateFaultProbability(std::ostream& out);
 
@@ -145,9 +190,22 @@ class Router : public BasicRouter, public Consumer
 
   private:
     Cycles m_latency;
+    // Router pipeline depth once the stages taken off by lookahead
+    // routing and speculative SA are removed
+    Cycles m_pipe_stages;
     uint32_t m_virtual_networks, m_vc_per_vnet, m_num_vcs;
     uint32_t m_bit_width;
+    GarnetSAPolicy m_sa_policy;
+    uint32_t m_sa_iterations;
     GarnetNetwork *m_network_ptr;
+    RandomStream m_rng;
+    VcStateTable m_vc_table;
+
+    // Input ports whose link, and output ports whose credit link, have
+    // arrivals in flight. Only these ports are visited on wakeup.
+    uint64_t m_pending_inports;
+    uint64_t m_pending_outports;
+    bool m_activity_masked;
 
     RoutingUnit routingUnit;
     SwitchAllocator switchAllocator;
@@ -162,8 +220,16 @@ class Router : public BasicRouter, public Consumer
 
     statistics::Scalar m_sw_input_arbiter_activity;
     statistics::Scalar m_sw_output_arbiter_activity;
+    statistics::Formula m_sa_matching_efficiency;
+    statistics::Scalar m_sa_failed_speculations;
+
+    // Head flits sent on each 3D torus channel class
+    statistics::Vector m_torus_channel_selections;
 
     statistics::Scalar m_crossbar_activity;
+
+    // Flit copies sent down the branches of multicast packets
+    statistics::Scalar m_multicast_replications;
 };
 
 } // namespace garnet
@@ -47,6 +47,8 @@ namespace garnet
 {
 
 RoutingUnit::RoutingUnit(Router *router)
+  : m_front_outport(-1), m_back_outport(-1), m_right_outport(-1),
+    m_left_outport(-1), m_up_outport(-1), m_down_outport(-1)
 {
     m_router = router;
     m_routing_table.clear();
@@ -94,7 +96,8 @@ RoutingUnit::supportsVnet(int vnet, std::vector<int> sVnets)
  * Correct weight assignments are critical to provide deadlock avoidance.
  */
 int
-RoutingUnit::lookupRoutingTable(int vnet, NetDest msg_destination)
+RoutingUnit::lookupRoutingTable(int vnet, const NetDest &msg_destination,
+                                RandomStream &rng)
 {
     // First find all possible output link candidates
     // For ordered vnet, just choose the first
@@ -138,36 +141,119 @@ RoutingUnit::lookupRoutingTable(int vnet, NetDest msg_destination)
     // Randomly select any candidate output link
     int candidate = 0;
     if (!(m_router->get_net_ptr())->isVNetOrdered(vnet))
-        candidate = rand() % num_candidates;
+        candidate = rng.random(num_candidates);
 
     output_link = output_link_candidates.at(candidate);
     return output_link;
 }
 
+// A unicast route has the single destination dest_ni, whose candidates
+// are read from the destination table. Multicast routes fall back to the
+// routing table.
+int
+RoutingUnit::lookupRoutingTable(const RouteInfo &route, RandomStream &rng)
+{
+    if (route.multicast || m_dest_offsets.empty())
+        return lookupRoutingTable(route.vnet, *route.net_dest, rng);
+
+    int vnet = route.vnet;
+    assert(route.dest_ni >= 0 && route.dest_ni + 1 <
+           m_dest_offsets[vnet].size());
+    uint32_t first = m_dest_offsets[vnet][route.dest_ni];
+    int num_candidates = m_dest_offsets[vnet][route.dest_ni + 1] - first;
+    fatal_if(num_candidates == 0,
+             "Fatal Error:: No Route exists from this Router.");
+
+    // Same selection as lookupRoutingTable(), among the same candidates
+    int candidate = 0;
+    if (!(m_router->get_net_ptr())->isVNetOrdered(vnet))
+        candidate = rng.random(num_candidates);
+
+    return m_dest_outports[vnet][first + candidate];
+}
 
 void
-RoutingUnit::addInDirection(PortDirection inport_dirn, int inport_idx)
+RoutingUnit::initDestTable()
 {
+    int num_nodes = MachineType_base_number(MachineType_NUM);
+    int num_vnets = m_routing_table.size();
+    m_dest_offsets.assign(num_vnets, std::vector<uint32_t>());
+    m_dest_outports.assign(num_vnets, std::vector<int>());
+
+    for (int vnet = 0; vnet < num_vnets; vnet++) {
+        // Min-weight candidate links of each destination, in link order
+        std::vector<std::vector<int>> candidates(num_nodes);
+        std::vector<int> min_weight(num_nodes, INFINITE_);
+        for (int link = 0; link < m_routing_table[vnet].size(); link++) {
+            int weight = m_weight_table[link];
+            for (NodeID node : m_routing_table[vnet][link].getAllDest()) {
+                assert(node < num_nodes);
+                if (weight < min_weight[node]) {
+                    min_weight[node] = weight;
+                    candidates[node].clear();
+                }
+                if (weight == min_weight[node])
+                    candidates[node].push_back(link);
+            }
+        }
+
+        m_dest_offsets[vnet].reserve(num_nodes + 1);
+        m_dest_offsets[vnet].push_back(0);
+        for (int node = 0; node < num_nodes; node++) {
+            m_dest_outports[vnet].insert(m_dest_outports[vnet].end(),
+                candidates[node].begin(), candidates[node].end());
+            m_dest_offsets[vnet].push_back(m_dest_outports[vnet].size());
+        }
+    }
+}
+
+
+void
+RoutingUnit::addInDirection(PortDirectionId inport_dirn, int inport_idx)
+{
+    assert(inport_dirn >= 0 && inport_idx >= 0);
+    if (inport_dirn >= m_inports_dirn2idx.size())
+        m_inports_dirn2idx.resize(inport_dirn + 1, -1);
+    if (inport_idx >= m_inports_idx2dirn.size())
+        m_inports_idx2dirn.resize(inport_idx + 1, UNKNOWN_DIRN_);
+
     m_inports_dirn2idx[inport_dirn] = inport_idx;
     m_inports_idx2dirn[inport_idx]  = inport_dirn;
 }
 
 void
-RoutingUnit::addOutDirection(PortDirection outport_dirn, int outport_idx)
+RoutingUnit::addOutDirection(PortDirectionId outport_dirn, int outport_idx)
 {
+    assert(outport_dirn >= 0 && outport_idx >= 0);
+    if (outport_dirn >= m_outports_dirn2idx.size())
+        m_outports_dirn2idx.resize(outport_dirn + 1, -1);
+    if (outport_idx >= m_outports_idx2dirn.size())
+        m_outports_idx2dirn.resize(outport_idx + 1, UNKNOWN_DIRN_);
+
     m_outports_dirn2idx[outport_dirn] = outport_idx;
     m_outports_idx2dirn[outport_idx]  = outport_dirn;
 }
 
+// Outport in the given direction, -1 if this router has none
+int
+RoutingUnit::getOutportOfDirection(PortDirectionId outport_dirn)
+{
+    if (outport_dirn < 0 || outport_dirn >= m_outports_dirn2idx.size())
+        return -1;
+    return m_outports_dirn2idx[outport_dirn];
+}
+
 // outportCompute() is called by the InputUnit
 // It calls the routing table by default.
+// Random choices are drawn from rng, the stream of the router or NI that
+// computes the route: with lookahead routing, that is the one upstream.
 // A template for adaptive topology-specific routing algorithm
 // implementations using port directions rather than a static routing
 // table is provided here.
 
 int
-RoutingUnit::outportCompute(RouteInfo route, int inport,
-                            PortDirection inport_dirn)
+RoutingUnit::outportCompute(const RouteInfo &route, int inport,
+                            PortDirectionId inport_dirn, RandomStream &rng)
 {
     int outport = -1;
 
@@ -176,7 +262,7 @@ RoutingUnit::outportCompute(RouteInfo route, int inport,
         // Multiple NIs may be connected to this router,
         // all with output port direction = "Local"
         // Get exact outport id from table
-        outport = lookupRoutingTable(route.vnet, route.net_dest);
+        outport = lookupRoutingTable(route, rng);
         return outport;
     }
 
@@ -189,7 +275,7 @@ RoutingUnit::outportCompute(RouteInfo route, int inport,
 
     switch (routing_algorithm) {
         case TABLE_:  outport =
-            lookupRoutingTable(route.vnet, route.net_dest); break;
+            lookupRoutingTable(route, rng); break;
         case XY_:     outport =
             outportComputeXY(route, inport, inport_dirn); break;
         case RING_:   outport =
@@ -198,7 +284,7 @@ RoutingUnit::outportCompute(RouteInfo route, int inport,
         case CUSTOM_: outport =
             outportComputeCustom(route, inport, inport_dirn); break;
         default: outport =
-            lookupRoutingTable(route.vnet, route.net_dest); break;
+            lookupRoutingTable(route, rng); break;
     }
 
     assert(outport != -1);
@@ -209,11 +295,11 @@ RoutingUnit::outportCompute(RouteInfo route, int inport,
 // Only for reference purpose in a Mesh
 // By default Garnet uses the routing table
 int
-RoutingUnit::outportComputeXY(RouteInfo route,
+RoutingUnit::outportComputeXY(const RouteInfo &route,
                               int inport,
-                              PortDirection inport_dirn)
+                              PortDirectionId inport_dirn)
 {
-    PortDirection outport_dirn = "Unknown";
+    PortDirectionId outport_dirn = UNKNOWN_DIRN_;
 
     [[maybe_unused]] int num_rows = m_router->get_net_ptr()->getNumRows();
     int num_cols = m_router->get_net_ptr()->getNumCols();
@@ -238,21 +324,21 @@ RoutingUnit::outportComputeXY(RouteInfo route,
 
     if (x_hops > 0) {
         if (x_dirn) {
-            assert(inport_dirn == "Local" || inport_dirn == "West");
-            outport_dirn = "East";
+            assert(inport_dirn == LOCAL_DIRN_ || inport_dirn == WEST_DIRN_);
+            outport_dirn = EAST_DIRN_;
         } else {
-            assert(inport_dirn == "Local" || inport_dirn == "East");
-            outport_dirn = "West";
+            assert(inport_dirn == LOCAL_DIRN_ || inport_dirn == EAST_DIRN_);
+            outport_dirn = WEST_DIRN_;
         }
     } else if (y_hops > 0) {
         if (y_dirn) {
             // "Local" or "South" or "West" or "East"
-            assert(inport_dirn != "North");
-            outport_dirn = "North";
+            assert(inport_dirn != NORTH_DIRN_);
+            outport_dirn = NORTH_DIRN_;
         } else {
             // "Local" or "North" or "West" or "East"
-            assert(inport_dirn != "South");
-            outport_dirn = "South";
+            assert(inport_dirn != SOUTH_DIRN_);
+            outport_dirn = SOUTH_DIRN_;
         }
     } else {
         // x_hops == 0 and y_hops == 0
@@ -261,26 +347,26 @@ RoutingUnit::outportComputeXY(RouteInfo route,
         panic("x_hops == y_hops == 0");
     }
 
-    return m_outports_dirn2idx[outport_dirn];
+    return getOutportOfDirection(outport_dirn);
 }
 
 // Template for implementing custom routing algorithm
 // using port directions. (Example adaptive)
 int
-RoutingUnit::outportComputeCustom(RouteInfo route,
+RoutingUnit::outportComputeCustom(const RouteInfo &route,
                                  int inport,
-                                 PortDirection inport_dirn)
+                                 PortDirectionId inport_dirn)
 {
     panic("%s placeholder executed", __FUNCTION__);
 }
 
 // Ring routing implemented using port directions
 int
-RoutingUnit::outportComputeRing(RouteInfo route,
+RoutingUnit::outportComputeRing(const RouteInfo &route,
                                 int inport,
-                                PortDirection inport_dirn)
+                                PortDirectionId inport_dirn)
 {
-    PortDirection outport_dirn = "Unknown";
+    PortDirectionId outport_dirn = UNKNOWN_DIRN_;
 
     int num_nodes = m_router->get_net_ptr()->getNumRouters();
 
@@ -295,38 +381,180 @@ RoutingUnit::outportComputeRing(RouteInfo route,
         if (dest_id > my_id) {
             if ( (dest_id - my_id) <= (num_nodes / 2)) {
                 // clockwise
-                assert(inport_dirn == "Local" || inport_dirn == "Left");
-                outport_dirn = "Right";
+                assert(inport_dirn == LOCAL_DIRN_ || inport_dirn == LEFT_DIRN_);
+                outport_dirn = RIGHT_DIRN_;
             } else {
                 // counter-clockwise
-                assert(inport_dirn == "Local" || inport_dirn == "Right");
-                outport_dirn = "Left";
+                assert(inport_dirn == LOCAL_DIRN_ || inport_dirn == RIGHT_DIRN_);
+                outport_dirn = LEFT_DIRN_;
             }
         } else {
             if ( (my_id - dest_id) <= (num_nodes / 2)) {
                 // counter-clockwise
-                assert(inport_dirn == "Local" || inport_dirn == "Right");
-                outport_dirn = "Left";
+                assert(inport_dirn == LOCAL_DIRN_ || inport_dirn == RIGHT_DIRN_);
+                outport_dirn = LEFT_DIRN_;
             } else {
                 // clockwise
-                assert(inport_dirn == "Local" || inport_dirn == "Left");
-                outport_dirn = "Right";
+                assert(inport_dirn == LOCAL_DIRN_ || inport_dirn == LEFT_DIRN_);
+                outport_dirn = RIGHT_DIRN_;
             }
         }
     } else {
         panic("hops == 0");
     }
 
-    return m_outports_dirn2idx[outport_dirn];
+    return getOutportOfDirection(outport_dirn);
 }
 
 
+// Set up the 3D torus routing once all ports have been added.
+// Caches the outport of each direction and, if build_table is set,
+// precomputes the candidate outports towards every other router so that
+// outportComputeXYZ() only needs one indexed load per head flit.
+void
+RoutingUnit::initTorusRouting(bool build_table)
+{
+    PortDirectionId dirns[] = {FRONT_DIRN_, BACK_DIRN_, RIGHT_DIRN_,
+                               LEFT_DIRN_, UP_DIRN_, DOWN_DIRN_};
+    int *outports[] = {&m_front_outport, &m_back_outport,
+                       &m_right_outport, &m_left_outport,
+                       &m_up_outport, &m_down_outport};
+    for (int i = 0; i < 6; i++) {
+        *outports[i] = getOutportOfDirection(dirns[i]);
+        fatal_if(*outports[i] == -1,
+                 "Router %d has no %s outport required by 3D torus routing",
+                 m_router->get_id(),
+                 m_router->getPortDirectionName(dirns[i]));
+    }
+
+    m_torus_route_table.clear();
+    if (!build_table)
+        return;
+
+    int num_routers = m_router->get_net_ptr()->getNumRouters();
+    m_torus_route_table.resize(num_routers);
+    for (int dest_id = 0; dest_id < num_routers; dest_id++) {
+        // Packets for this router leave through a Local outport which
+        // depends on the destination NI, see outportComputeXYZ()
+        if (dest_id != m_router->get_id())
+            m_torus_route_table[dest_id] = computeTorusCandidates(dest_id);
+    }
+}
+
+// Split a multicast packet into its branches at this router, one per
+// (outport, VC classes) its destinations are routed to. Each destination
+// is routed as a unicast packet, except that the 3D torus routing takes
+// its escape candidate, so that every branch follows a deterministic
+// dimension-order tree. With more than one branch, each gets a route of
+// its own holding its share of the destinations.
+void
+RoutingUnit::outportComputeMulticast(const RouteInfo &route,
+                                     int inport,
+                                     PortDirectionId inport_dirn,
+                                     std::vector<MulticastBranch> &branches)
+{
+    GarnetNetwork *net_ptr = m_router->get_net_ptr();
+    bool torus = (net_ptr->getRoutingAlgorithm() == XYZ_);
+
+    branches.clear();
+    std::vector<NetDest> branch_dests;
+    std::vector<NodeID> branch_nodes;
+    NetDest dests = *route.net_dest;
+    for (NodeID node : dests.getAllDest()) {
+        NetDest node_dest = net_ptr->getNodeDest(node);
+        RouteInfo node_route;
+        node_route.copyHeader(route);
+        node_route.net_dest = &node_dest;
+        node_route.dest_ni = node;
+        node_route.dest_router = net_ptr->get_router_id(node, route.vnet);
+        node_route.multicast = false;
+
+        int outport = -1;
+        VcClassMask vc_classes = ALL_VC_CLASSES_;
+        if (torus) {
+            OutportCandidates candidates =
+                outportComputeXYZ(node_route, inport, inport_dirn,
+                                  m_router->get_rng());
+            VcClassMask escape = vcClassBit(GarnetVcClass::escape);
+            for (int i = 0; i < candidates.size(); i++) {
+                if (candidates.get_vc_classes(i) & escape) {
+                    outport = candidates.get_outport(i);
+                    vc_classes = candidates.get_vc_classes(i);
+                    break;
+                }
+            }
+        } else {
+            outport = outportCompute(node_route, inport, inport_dirn,
+                                     m_router->get_rng());
+        }
+        assert(outport != -1);
+
+        int branch = 0;
+        while (branch < branches.size() &&
+               (branches[branch].outport != outport ||
+                branches[branch].vc_classes != vc_classes)) {
+            branch++;
+        }
+        if (branch == branches.size()) {
+            branches.push_back({outport, vc_classes, -1, nullptr});
+            branch_dests.emplace_back();
+            branch_nodes.push_back(node);
+        }
+        branch_dests[branch].addNetDest(node_dest);
+    }
+    assert(!branches.empty());
+
+    // A single branch keeps the route of the packet
+    if (branches.size() == 1)
+        return;
+
+    for (int branch = 0; branch < branches.size(); branch++) {
+        RouteInfo *branch_route =
+            new (m_router->get_flit_pool()) RouteInfo();
+        branch_route->copyHeader(route);
+        branch_route->branch_dest.emplace(std::move(branch_dests[branch]));
+        branch_route->net_dest = &*branch_route->branch_dest;
+        if (branch_route->branch_dest->count() == 1) {
+            NodeID node = branch_nodes[branch];
+            branch_route->dest_ni = node;
+            branch_route->dest_router =
+                net_ptr->get_router_id(node, route.vnet);
+            branch_route->multicast = false;
+        }
+        branches[branch].route = RouteInfoPtr(branch_route);
+    }
+}
+
 // 3D Torus routing impelemented using port directions
-// The return value is the set of all possible (PortDirection, R1/R2)
-std::set<std::pair<int, bool>>
-RoutingUnit::outportComputeXYZ(RouteInfo route,
+// The return value is the set of all possible (outport, R1/R2)
+// candidates, R1 channels use the adaptive VC class and R2 channels
+// the escape class
+OutportCandidates
+RoutingUnit::outportComputeXYZ(const RouteInfo &route,
                                int inport,
-                               PortDirection inport_dirn)
+                               PortDirectionId inport_dirn,
+                               RandomStream &rng)
+{
+    if (route.dest_router == m_router->get_id()) {
+        OutportCandidates output_ports;
+        int outport = lookupRoutingTable(route, rng);
+        output_ports.add(outport, vcClassBit(GarnetVcClass::escape));
+        output_ports.add(outport, vcClassBit(GarnetVcClass::adaptive));
+        return output_ports;
+    }
+
+    if (!m_torus_route_table.empty()) {
+        assert(!m_torus_route_table[route.dest_router].empty());
+        return m_torus_route_table[route.dest_router];
+    }
+
+    // Route table too large for this torus, compute the route per flit
+    return computeTorusCandidates(route.dest_router);
+}
+
+// Candidate outports from this router towards dest_id (!= this router)
+OutportCandidates
+RoutingUnit::computeTorusCandidates(int dest_id)
 {
     int num_xs = m_router->get_net_ptr()->getNumXs();
     int num_ys = m_router->get_net_ptr()->getNumYs();
@@ -340,20 +568,12 @@ RoutingUnit::outportComputeXYZ(RouteInfo route,
     assert(my_id == my_x + my_y * num_xs + my_z * num_xs * num_ys);
     //std::cout<<"my_router "<<my_id<<" = "<<" ( "<<my_x<<", "<<my_y<<", "<<my_z<<")\n";//////////////////
 
-    int dest_id = route.dest_router;
     int dest_x = dest_id % num_xs;
     int dest_y = ((int)(dest_id / num_xs)) % num_ys;
     int dest_z = (dest_id- dest_x - dest_y * num_xs) / (num_xs * num_ys);
     assert(dest_id == dest_x + dest_y * num_xs + dest_z * num_xs * num_ys);
     //std::cout<<"dest_router "<<dest_id<<" = "<<" ( "<<dest_x<<", "<<dest_y<<", "<<dest_z<<")\n";//////////////////
 
-    if (dest_id == my_id) {
-        std::set<std::pair<int, bool>> output_ports;
-        int outport = lookupRoutingTable(route.vnet, route.net_dest);
-        output_ports.emplace(outport, 0);
-        output_ports.emplace(outport, 1);
-        return output_ports;
-    }
     assert(dest_id != my_id);
 
     int x_hops = abs(dest_x - my_x);
@@ -435,19 +655,21 @@ RoutingUnit::outportComputeXYZ(RouteInfo route,
     }
 
     // Put possible directions into the set `output_ports`
-    std::set<std::pair<int, bool>> output_ports;
-    if (x_dirn1_en && x_dirn1) {output_ports.emplace(m_outports_dirn2idx["Front"], 1);}
-    if (x_dirn2_en && x_dirn2) {output_ports.emplace(m_outports_dirn2idx["Front"], 0);}
-    if (x_dirn1_en && (!x_dirn1)) {output_ports.emplace(m_outports_dirn2idx["Back"], 1);}
-    if (x_dirn2_en && (!x_dirn2)) {output_ports.emplace(m_outports_dirn2idx["Back"], 0);}
-    if (y_dirn1_en && y_dirn1) {output_ports.emplace(m_outports_dirn2idx["Right"], 1);}
-    if (y_dirn2_en && y_dirn2) {output_ports.emplace(m_outports_dirn2idx["Right"], 0);}
-    if (y_dirn1_en && (!y_dirn1)) {output_ports.emplace(m_outports_dirn2idx["Left"], 1);}
-    if (y_dirn2_en && (!y_dirn2)) {output_ports.emplace(m_outports_dirn2idx["Left"], 0);}
-    if (z_dirn1_en && z_dirn1) {output_ports.emplace(m_outports_dirn2idx["Up"], 1);}
-    if (z_dirn2_en && z_dirn2) {output_ports.emplace(m_outports_dirn2idx["Up"], 0);}
-    if (z_dirn1_en && (!z_dirn1)) {output_ports.emplace(m_outports_dirn2idx["Down"], 1);}
-    if (z_dirn2_en && (!z_dirn2)) {output_ports.emplace(m_outports_dirn2idx["Down"], 0);}
+    const VcClassMask r1 = vcClassBit(GarnetVcClass::adaptive);
+    const VcClassMask r2 = vcClassBit(GarnetVcClass::escape);
+    OutportCandidates output_ports;
+    if (x_dirn1_en && x_dirn1) {output_ports.add(m_front_outport, r1);}
+    if (x_dirn2_en && x_dirn2) {output_ports.add(m_front_outport, r2);}
+    if (x_dirn1_en && (!x_dirn1)) {output_ports.add(m_back_outport, r1);}
+    if (x_dirn2_en && (!x_dirn2)) {output_ports.add(m_back_outport, r2);}
+    if (y_dirn1_en && y_dirn1) {output_ports.add(m_right_outport, r1);}
+    if (y_dirn2_en && y_dirn2) {output_ports.add(m_right_outport, r2);}
+    if (y_dirn1_en && (!y_dirn1)) {output_ports.add(m_left_outport, r1);}
+    if (y_dirn2_en && (!y_dirn2)) {output_ports.add(m_left_outport, r2);}
+    if (z_dirn1_en && z_dirn1) {output_ports.add(m_up_outport, r1);}
+    if (z_dirn2_en && z_dirn2) {output_ports.add(m_up_outport, r2);}
+    if (z_dirn1_en && (!z_dirn1)) {output_ports.add(m_down_outport, r1);}
+    if (z_dirn2_en && (!z_dirn2)) {output_ports.add(m_down_outport, r2);}
 
     assert(output_ports.size() > 0 && output_ports.size() <= 4);
 
@@ -35,6 +35,7 @@
 #include "mem/ruby/common/NetDest.hh"
 #include "mem/ruby/network/garnet/CommonTypes.hh"
 #include "mem/ruby/network/garnet/GarnetNetwork.hh"
+#include "mem/ruby/network/garnet/RandomStream.hh"
 #include "mem/ruby/network/garnet/flit.hh"
 
 namespace gem5
@@ -53,40 +54,56 @@ class RoutingUnit
 {
   public:
     RoutingUnit(Router *router);
-    int outportCompute(RouteInfo route,
+    int outportCompute(const RouteInfo &route,
                       int inport,
-                      PortDirection inport_dirn);
+                      PortDirectionId inport_dirn,
+                      RandomStream &rng);
 
     // Topology-agnostic Routing Table based routing (default)
     void addRoute(std::vector<NetDest>& routing_table_entry);
     void addWeight(int link_weight);
 
     // get output port from routing table
-    int  lookupRoutingTable(int vnet, NetDest net_dest);
+    int  lookupRoutingTable(int vnet, const NetDest &net_dest,
+                            RandomStream &rng);
+    int  lookupRoutingTable(const RouteInfo &route, RandomStream &rng);
+
+    // Flatten the routing table into the destination table, once the
+    // topology has added all the routes
+    void initDestTable();
 
     // Topology-specific direction based routing
-    void addInDirection(PortDirection inport_dirn, int inport);
-    void addOutDirection(PortDirection outport_dirn, int outport);
+    void addInDirection(PortDirectionId inport_dirn, int inport);
+    void addOutDirection(PortDirectionId outport_dirn, int outport);
+    int getOutportOfDirection(PortDirectionId outport_dirn);
 
     // Routing for Mesh
-    int outportComputeXY(RouteInfo route,
+    int outportComputeXY(const RouteInfo &route,
                          int inport,
-                         PortDirection inport_dirn);
+                         PortDirectionId inport_dirn);
 
     // Routing for Ring
-    int outportComputeRing(RouteInfo route,
+    int outportComputeRing(const RouteInfo &route,
                            int inport,
-                           PortDirection inport_dirn);
+                           PortDirectionId inport_dirn);
 
     // Routing for 3D Torus
-    std::set<std::pair<int, bool>> outportComputeXYZ(RouteInfo route,
-                               int inport,
-                               PortDirection inport_dirn);
+    void initTorusRouting(bool build_table);
+    OutportCandidates outportComputeXYZ(const RouteInfo &route,
+                                        int inport,
+                                        PortDirectionId inport_dirn,
+                                        RandomStream &rng);
 
     // Custom Routing Algorithm using Port Directions
-    int outportComputeCustom(RouteInfo route,
+    int outportComputeCustom(const RouteInfo &route,
                              int inport,
-                             PortDirection inport_dirn);
+                             PortDirectionId inport_dirn);
+
+    // Multicast routing on top of any of the algorithms above
+    void outportComputeMulticast(const RouteInfo &route,
+                                 int inport,
+                                 PortDirectionId inport_dirn,
+                                 std::vector<MulticastBranch> &branches);
 
     // Returns true if vnet is present in the vector
     // of vnets or if the vector supports all vnets.
@@ -94,17 +111,35 @@ class RoutingUnit
 
 
   private:
+    OutportCandidates computeTorusCandidates(int dest_id);
+
     Router *m_router;
 
     // Routing Table
     std::vector<std::vector<NetDest>> m_routing_table;
     std::vector<int> m_weight_table;
 
-    // Inport and Outport direction to idx maps
-    std::map<PortDirection, int> m_inports_dirn2idx;
-    std::map<int, PortDirection> m_inports_idx2dirn;
-    std::map<int, PortDirection> m_outports_idx2dirn;
-    std::map<PortDirection, int> m_outports_dirn2idx;
+    // Destination table: the min-weight candidate outports to destination
+    // node d in vnet v are m_dest_outports[v][i] for i in
+    // [m_dest_offsets[v][d], m_dest_offsets[v][d + 1])
+    std::vector<std::vector<uint32_t>> m_dest_offsets;
+    std::vector<std::vector<int>> m_dest_outports;
+
+    // Inport and Outport direction to idx maps,
+    // indexed by direction id and port idx respectively (-1 if unused)
+    std::vector<int> m_inports_dirn2idx;
+    std::vector<PortDirectionId> m_inports_idx2dirn;
+    std::vector<PortDirectionId> m_outports_idx2dirn;
+    std::vector<int> m_outports_dirn2idx;
+
+    // 3D Torus outports, cached by initTorusRouting()
+    int m_front_outport, m_back_outport;
+    int m_right_outport, m_left_outport;
+    int m_up_outport, m_down_outport;
+
+    // 3D Torus candidate outports indexed by destination router.
+    // Empty if the table would be too large, see GarnetNetwork::init().
+    std::vector<OutportCandidates> m_torus_route_table;
 };
 
 } // namespace garnet
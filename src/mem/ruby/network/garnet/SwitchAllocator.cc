@@ -31,6 +31,8 @@
 
 #include "mem/ruby/network/garnet/SwitchAllocator.hh"
 
+#include <algorithm>
+
 #include "debug/RubyNetwork.hh"
 #include "mem/ruby/network/garnet/GarnetNetwork.hh"
 #include "mem/ruby/network/garnet/InputUnit.hh"
@@ -46,15 +48,75 @@ namespace ruby
 namespace garnet
 {
 
+namespace
+{
+
+// Rotate the low num_bits bits of vcs right by shift, so that bit
+// shift comes first when the result is walked from the lowest set bit.
+inline uint64_t
+rotateRight(uint64_t vcs, int shift, int num_bits)
+{
+    if (shift == 0)
+        return vcs;
+    return ((vcs >> shift) | (vcs << (num_bits - shift))) & mask(num_bits);
+}
+
+// Round robin arbiter: the first requester at or after ptr.
+inline int
+rrSelect(uint64_t requests, int ptr, int num_bits)
+{
+    assert(requests != 0);
+    int winner = ptr + ctz64(rotateRight(requests, ptr, num_bits));
+    return (winner >= num_bits) ? winner - num_bits : winner;
+}
+
+// Matrix arbiter: bit j of priority[i] is set when requester i has
+// priority over requester j. The priorities always form a total order,
+// so exactly one requester beats all the others.
+void
+lrsInit(std::vector<uint64_t> &priority, int num_bits)
+{
+    priority.resize(num_bits);
+    for (int i = 0; i < num_bits; i++)
+        priority[i] = mask(num_bits) & ~mask(i + 1);
+}
+
+inline int
+lrsSelect(const std::vector<uint64_t> &priority, uint64_t requests)
+{
+    for (uint64_t r = requests; r; r &= r - 1) {
+        int i = ctz64(r);
+        if ((requests & ~priority[i]) == ((uint64_t)1 << i))
+            return i;
+    }
+    panic("Matrix arbiter found no winner");
+}
+
+// The last winner gets the lowest priority.
+inline void
+lrsUpdate(std::vector<uint64_t> &priority, int winner)
+{
+    for (auto &row : priority)
+        row |= (uint64_t)1 << winner;
+    priority[winner] = 0;
+}
+
+} // anonymous namespace
+
 SwitchAllocator::SwitchAllocator(Router *router)
     : Consumer(router)
 {
     m_router = router;
     m_num_vcs = m_router->get_num_vcs();
     m_vc_per_vnet = m_router->get_vc_per_vnet();
-
+    m_policy = m_router->get_sa_policy();
+    m_iterations = m_router->get_sa_iterations();
     m_input_arbiter_activity = 0;
     m_output_arbiter_activity = 0;
+    m_failed_speculations = 0;
+    m_multicast_replications = 0;
+    std::fill(std::begin(m_torus_channel_selections),
+              std::end(m_torus_channel_selections), 0);
 }
 
 void
@@ -66,6 +128,38 @@ SwitchAllocator::init()
     m_round_robin_invc.resize(m_num_inports);
     m_port_requests.resize(m_num_inports);
     m_vc_winners.resize(m_num_inports);
+    m_speculative_requests.assign(m_num_inports, false);
+    m_round_robin_va = 0;
+    m_lookahead = m_router->get_net_ptr()->isLookaheadRouting();
+    m_speculative = m_router->get_net_ptr()->isSpeculativeSA();
+    m_virtual_cut_through = m_router->get_net_ptr()->isVirtualCutThrough();
+    m_torus_selection = m_router->get_net_ptr()->getTorusSelection();
+
+    m_torus_channels.assign(m_num_outports, -1);
+    m_regional_outports.assign(m_num_outports, nullptr);
+    if (m_router->get_net_ptr()->getRoutingAlgorithm() == XYZ_) {
+        for (int outport = 0; outport < m_num_outports; outport++) {
+            PortDirectionId dirn = m_router->getOutportDirection(outport);
+            switch (dirn) {
+              case FRONT_DIRN_: m_torus_channels[outport] = R1xp; break;
+              case BACK_DIRN_:  m_torus_channels[outport] = R1xn; break;
+              case RIGHT_DIRN_: m_torus_channels[outport] = R1yp; break;
+              case LEFT_DIRN_:  m_torus_channels[outport] = R1yn; break;
+              case UP_DIRN_:    m_torus_channels[outport] = R1zp; break;
+              case DOWN_DIRN_:  m_torus_channels[outport] = R1zn; break;
+              default: continue;
+            }
+
+            Router *next =
+                m_router->getOutputUnit(outport)->get_next_router();
+            int next_outport =
+                next ? next->get_outport_of_direction(dirn) : -1;
+            if (next_outport != -1) {
+                m_regional_outports[outport] =
+                    next->getOutputUnit(next_outport);
+            }
+        }
+    }
 
     for (int i = 0; i < m_num_inports; i++) {
         m_round_robin_invc[i] = 0;
@@ -76,13 +170,44 @@ SwitchAllocator::init()
     for (int i = 0; i < m_num_outports; i++) {
         m_round_robin_inport[i] = 0;
     }
+
+    if (m_policy == GarnetSAPolicy::separable)
+        return;
+
+    fatal_if(m_speculative, "Speculative SA is only supported by the "
+             "separable switch allocator.");
+
+    fatal_if(m_num_inports > 64 || m_num_outports > 64,
+             "Router %d has %d inports and %d outports, the %s switch "
+             "allocator supports at most 64.", m_router->get_id(),
+             m_num_inports, m_num_outports,
+             GarnetSAPolicyStrings[(int)m_policy]);
+    fatal_if(m_iterations < 1, "iSLIP needs at least one iteration.");
+
+    m_inport_requests.assign(m_num_inports, 0);
+    m_outport_requests.assign(m_num_outports, 0);
+    m_request_vcs.assign(m_num_inports, std::vector<int>(m_num_outports, -1));
+    m_round_robin_outport.assign(m_num_inports, 0);
+    m_inport_grants.assign(m_num_inports, 0);
+    m_outport_bids.assign(m_num_outports, 0);
+    m_inport_lrs.resize(m_num_inports);
+    for (auto &priority : m_inport_lrs)
+        lrsInit(priority, m_num_outports);
+    m_outport_lrs.resize(m_num_outports);
+    for (auto &priority : m_outport_lrs)
+        lrsInit(priority, m_num_inports);
 }
 
 /*
  * The wakeup function of the SwitchAllocator performs a 2-stage
  * seperable switch allocation. At the end of the 2nd stage, a free
  * output VC is assigned to the winning flits of each output port.
- * There is no separate VCAllocator stage like the one in garnet1.0.
+ * There is no separate VCAllocator stage like the one in garnet1.0,
+ * except with speculative SA, where VC allocation runs in parallel with
+ * the two stages (see allocate_vcs).
+ * The other policies first collect the requests of all the ready input
+ * VCs and compute a matching between input and output ports, which is
+ * then granted the same way.
  * At the end of this function, the router is rescheduled to wakeup
  * next cycle for peforming SA for any flits ready next cycle.
  */
@@ -90,16 +215,39 @@ SwitchAllocator::init()
 void
 SwitchAllocator::wakeup()
 {
-    arbitrate_inports(); // First stage of allocation
-    arbitrate_outports(); // Second stage of allocation
+    switch (m_policy) {
+      case GarnetSAPolicy::separable:
+        arbitrate_inports(); // First stage of allocation
+        if (m_speculative)
+            allocate_vcs(); // VC allocation, in parallel with SA
+        arbitrate_outports(); // Second stage of allocation
+        break;
+      case GarnetSAPolicy::islip:
+        collect_requests();
+        match_islip();
+        grant_matches();
+        break;
+      case GarnetSAPolicy::wavefront:
+        collect_requests();
+        match_wavefront();
+        grant_matches();
+        break;
+      case GarnetSAPolicy::matrix:
+        collect_requests();
+        match_matrix();
+        grant_matches();
+        break;
+      default:
+        panic("Unknown switch allocation policy");
+    }
 
     clear_request_vector();
     check_for_wakeup();
 }
 
 /*
- * SA-I (or SA-i) loops through all input VCs at every input port,
- * and selects one in a round robin manner.
+ * SA-I (or SA-i) loops through all input VCs holding flits at every input
+ * port, and selects one in a round robin manner.
  *    - For HEAD/HEAD_TAIL flits only selects an input VC whose output port
  *     has at least one free output VC.
  *    - For BODY/TAIL flits, only selects an input VC that has credits
@@ -115,61 +263,127 @@ SwitchAllocator::arbitrate_inports()
     // Select a VC from each input in a round robin manner
     // Independent arbiter at each input port
     for (int inport = 0; inport < m_num_inports; inport++) {
-        int invc = m_round_robin_invc[inport];
-
-        for (int invc_iter = 0; invc_iter < m_num_vcs; invc_iter++) {
-            auto input_unit = m_router->getInputUnit(inport);
-
-            if (input_unit->need_stage(invc, SA_, curTick())) {
-                // This flit is in SA stage
-                bool make_request;
-                int outport;
-                int outvc;
-                if (!torus) {
-                    if (wormhole) {
-                        flit* t_flit = input_unit->peekTopFlit(invc);
-                        input_unit->grant_outport(invc, t_flit->get_outport());
-                        input_unit->grant_outvc(invc, -1);
-                    }
-                    outport = input_unit->get_outport(invc);
-                    outvc = input_unit->get_outvc(invc);
-                    // check if the flit in this InputVC is allowed to be sent
-                    // send_allowed conditions described in that function.
-                    assert(outport >= 0);
-                    make_request = send_allowed(inport, invc, outport, outvc, wormhole, -1);
-                } else {
-                    // 3D Torus customed routing
-                    outport = input_unit->get_outport(invc);
-                    outvc = input_unit->get_outvc(invc);
-                    if (outvc == -1) {
-                        // HEAD_ / HEAD_TAIL_
-                        std::set<std::pair<int, bool>> outports = input_unit->get_outports(invc);
-                        assert(outports.size() > 0 && outports.size() <= 4);
-                        make_request = torus_send_allowed(inport, invc, outports);
-                        outport = input_unit->get_outport(invc);
-                        outvc = input_unit->get_outvc(invc);
-                        if (make_request) {assert(outport >= 0 && outvc == -1);}
-                    } else {
-                        assert(outport >= 0 && outvc >= 0);
-                        int firsthalf = (input_unit->get_firsthalf(invc)) ? 1 : 0;
-                        make_request = send_allowed(inport, invc, outport, outvc, wormhole, firsthalf);
-                    }
-                }
+        auto input_unit = m_router->getInputUnit(inport);
 
-                if (make_request) {
-                    m_input_arbiter_activity++;
+        // Walk the VCs whose head flit is in SA stage in round robin
+        // order starting from m_round_robin_invc[inport]
+        int rr_invc = m_round_robin_invc[inport];
+        uint64_t vcs = rotateRight(input_unit->get_sa_ready_vcs(curTick()),
+                                   rr_invc, m_num_vcs);
+
+        for (; vcs; vcs &= vcs - 1) {
+            int invc = rr_invc + ctz64(vcs);
+            if (invc >= m_num_vcs)
+                invc -= m_num_vcs;
+
+            int outport;
+            bool speculative;
+            if (!sa_request(inport, invc, wormhole, torus, outport,
+                            speculative))
+                continue;
+
+            if (speculative) {
+                // Non-speculative requests go first: keep the first
+                // speculative one in case no other VC places a request
+                if (m_port_requests[inport] == -1) {
                     m_port_requests[inport] = outport;
                     m_vc_winners[inport] = invc;
-
-                    break; // got one vc winner for this port
+                    m_speculative_requests[inport] = true;
                 }
+                continue;
             }
 
-            invc++;
-            if (invc >= m_num_vcs)
-                invc = 0;
+            m_port_requests[inport] = outport;
+            m_vc_winners[inport] = invc;
+            m_speculative_requests[inport] = false;
+
+            break; // got one vc winner for this port
+        }
+
+        if (m_port_requests[inport] != -1)
+            m_input_arbiter_activity++;
+    }
+}
+
+/*
+ * Checks whether the flit at the head of invc is in SA stage and allowed
+ * to be sent, and returns the output port it requests in outport.
+ * For 3D torus routing, a HEAD/HEAD_TAIL flit is granted one of its legal
+ * candidate output ports here.
+ * With speculative SA, VC allocation runs in parallel with SA, so a
+ * HEAD/HEAD_TAIL flit without an output VC requests the switch whether or
+ * not an output VC is free. Such a request is marked speculative, and is
+ * discarded if the flit does not get an output VC in VC allocation.
+ */
+
+bool
+SwitchAllocator::sa_request(int inport, int invc, bool wormhole, bool torus,
+                            int &outport, bool &speculative)
+{
+    speculative = false;
+    auto input_unit = m_router->getInputUnit(inport);
+    // Only VCs from the SA ready mask of the input unit get here
+    assert(input_unit->need_stage(invc, SA_, curTick()));
+
+    // This flit is in SA stage
+    bool make_request;
+    int outvc;
+    // Multicast packets have their branches, with fixed outports, also
+    // under 3D torus routing
+    if (!torus || input_unit->has_branches(invc)) {
+        if (wormhole) {
+            flit* t_flit = input_unit->peekTopFlit(invc);
+            input_unit->grant_outport(invc, t_flit->get_outport());
+            input_unit->grant_outvc(invc, -1);
+        }
+        outport = input_unit->get_outport(invc);
+        outvc = input_unit->get_outvc(invc);
+        assert(outport >= 0);
+        if (outvc == -1 && input_unit->has_branches(invc)) {
+            // A multicast head flit needs an output VC on every branch,
+            // so it never requests the switch speculatively
+            make_request = branches_allowed(inport, invc);
+        } else {
+            // check if the flit in this InputVC is allowed to be sent
+            // send_allowed conditions described in that function.
+            make_request = send_allowed(inport, invc, outport, outvc,
+                                        wormhole,
+                                        input_unit->get_vc_classes(invc));
+            if (m_speculative && outvc == -1) {
+                if (!make_request)
+                    make_request = order_allowed(inport, invc, outport);
+                speculative = make_request;
+            }
+        }
+    } else {
+        // 3D Torus customed routing
+        outport = input_unit->get_outport(invc);
+        outvc = input_unit->get_outvc(invc);
+        if (outvc == -1) {
+            // HEAD_ / HEAD_TAIL_
+            const OutportCandidates &outports =
+                input_unit->get_outports(invc);
+            assert(outports.size() > 0 && outports.size() <= 4);
+            make_request = torus_send_allowed(inport, invc, outports,
+                                              false);
+            if (m_speculative) {
+                if (!make_request) {
+                    make_request = torus_send_allowed(inport, invc,
+                                                      outports, true);
+                }
+                speculative = make_request;
+            }
+            outport = input_unit->get_outport(invc);
+            outvc = input_unit->get_outvc(invc);
+            if (make_request) {assert(outport >= 0 && outvc == -1);}
+        } else {
+            assert(outport >= 0 && outvc >= 0);
+            make_request = send_allowed(inport, invc, outport, outvc,
+                                        wormhole,
+                                        input_unit->get_vc_classes(invc));
         }
     }
+    return make_request;
 }
 
 /*
@@ -184,138 +398,409 @@ SwitchAllocator::arbitrate_inports()
  * An increment_credit signal is sent from the InputUnit
  * to the upstream router. For HEAD_TAIL/TAIL flits, is_free_signal in the
  * credit is set to true.
+ * Speculative requests only win an output port that no non-speculative
+ * request asks for.
  */
 
 void
 SwitchAllocator::arbitrate_outports()
 {
     bool wormhole = m_router->get_net_ptr()->isWormholeEnabled();
-    bool torus = (m_router->get_net_ptr()->getRoutingAlgorithm() == XYZ_);
     // Now there are a set of input vc requests for output vcs.
     // Again do round robin arbitration on these requests
     // Independent arbiter at each output port
     for (int outport = 0; outport < m_num_outports; outport++) {
         int inport = m_round_robin_inport[outport];
+        int winner = -1;
 
         for (int inport_iter = 0; inport_iter < m_num_inports;
                  inport_iter++) {
 
             // inport has a request this cycle for outport
-            if (m_port_requests[inport] == outport) {
-                auto output_unit = m_router->getOutputUnit(outport);
-                auto input_unit = m_router->getInputUnit(inport);
-
-                // grant this outport to this inport
-                int invc = m_vc_winners[inport];
-
-                int outvc = input_unit->get_outvc(invc);
-                if (outvc == -1) {
-                    // VC Allocation - select any free VC from outport
-                    if (!torus) {outvc = vc_allocate(outport, inport, invc, wormhole, -1);}
-                    else {
-                        int firsthalf = (input_unit->get_firsthalf(invc))? 1 : 0;
-                        outvc = vc_allocate(outport, inport, invc, wormhole, firsthalf);
-                    }
-                }
+            if (m_port_requests[inport] == outport &&
+                (winner == -1 || (m_speculative_requests[winner] &&
+                                  !m_speculative_requests[inport]))) {
+                winner = inport;
+                if (!m_speculative_requests[winner])
+                    break; // got a input winner for this outport
+            }
 
-                // remove flit from Input VC
-                flit *t_flit = input_unit->getTopFlit(invc);
-
-                DPRINTF(RubyNetwork, "SwitchAllocator at Router %d "
-                                     "granted outvc %d at outport %d "
-                                     "to invc %d at inport %d to flit %s at "
-                                     "cycle: %lld\n",
-                        m_router->get_id(), outvc,
-                        m_router->getPortDirectionName(
-                            output_unit->get_direction()),
-                        invc,
-                        m_router->getPortDirectionName(
-                            input_unit->get_direction()),
-                            *t_flit,
-                        m_router->curCycle());
-
-
-                // Update outport field in the flit since this is
-                // used by CrossbarSwitch code to send it out of
-                // correct outport.
-                // Note: post route compute in InputUnit,
-                // outport is updated in VC, but not in flit
-                if (wormhole) {assert(t_flit->get_outport() == outport);}
-                else {t_flit->set_outport(outport);}
-
-                // set outvc (i.e., invc for next hop) in flit
-                // (This was updated in VC by vc_allocate, but not in flit)
-                t_flit->set_vc(outvc);
-
-                // decrement credit in outvc
-                output_unit->decrement_credit(outvc);
-
-                // flit ready for Switch Traversal
-                t_flit->advance_stage(ST_, curTick());
-                m_router->grant_switch(inport, t_flit);
-                m_output_arbiter_activity++;
-
-                if (!wormhole) {
-                    if ((t_flit->get_type() == TAIL_) ||
-                        t_flit->get_type() == HEAD_TAIL_) {
-
-                        // This Input VC should now be empty
-                        assert(!(input_unit->isReady(invc, curTick())));
-
-                        // Free this VC
-                        input_unit->set_vc_idle(invc, curTick());
-
-                        // Send a credit back
-                        // along with the information that this VC is now idle
-                        input_unit->increment_credit(invc, true, curTick());
-                    } else {
-                        // Send a credit back
-                        // but do not indicate that the VC is idle
-                        input_unit->increment_credit(invc, false, curTick());
-                    }
-                } else {
-                    if (!(input_unit->isReady(invc, curTick()))) {
-                        // This Input VC is now empty
-                        // Free this VC
-                        input_unit->set_vc_idle(invc, curTick());
-
-                        // Send a credit back
-                        // along with the information that this VC is now idle
-                        input_unit->increment_credit(invc, true, curTick());
-                    } else {
-                        // Send a credit back
-                        // but do not indicate that the VC is idle
-                        input_unit->increment_credit(invc, false, curTick());
-                    }
-                }
+            inport++;
+            if (inport >= m_num_inports)
+                inport = 0;
+        }
+
+        if (winner != -1) {
+            sa_grant(winner, outport, wormhole);
+
+            // Update Round Robin pointer
+            m_round_robin_inport[outport] = winner + 1;
+            if (m_round_robin_inport[outport] >= m_num_inports)
+                m_round_robin_inport[outport] = 0;
+        }
+    }
+}
 
-                // remove this request
-                m_port_requests[inport] = -1;
+// Grant outport to the winning VC of inport (m_vc_winners[inport]):
+// allocate an output VC if needed and send the flit to the crossbar.
+void
+SwitchAllocator::sa_grant(int inport, int outport, bool wormhole)
+{
+    auto output_unit = m_router->getOutputUnit(outport);
+    auto input_unit = m_router->getInputUnit(inport);
 
-                // Update Round Robin pointer
+    // grant this outport to this inport
+    int invc = m_vc_winners[inport];
+
+    int outvc = input_unit->get_outvc(invc);
+    if (outvc == -1 && input_unit->has_branches(invc)) {
+        // VC Allocation for all the branches of a multicast head flit.
+        // The VCs that were free when it placed its request may have
+        // been taken by an earlier grant this cycle: the switch stays
+        // idle and the flit retries SA the next one.
+        if (!allocate_branch_vcs(inport, invc)) {
+            m_port_requests[inport] = -1;
+            return;
+        }
+        outvc = input_unit->get_outvc(invc);
+    } else if (outvc == -1 && m_speculative) {
+        // Failed speculation: the flit won the switch but no output VC in
+        // VC allocation (see allocate_vcs). The grant is discarded, the
+        // switch stays idle this cycle and the flit retries SA the next
+        // one.
+        assert(m_speculative_requests[inport]);
+        m_failed_speculations++;
+        m_port_requests[inport] = -1;
+        return;
+    } else if (outvc == -1) {
+        // VC Allocation - select a free VC of the allowed classes
+        // from outport
+        outvc = vc_allocate(outport, inport, invc, wormhole);
+
+        if (outvc == -1) {
+            // The switch was granted but a multicast head flit took the
+            // last free output VC this cycle. The switch stays idle this
+            // cycle and the flit retries SA the next one.
+            m_port_requests[inport] = -1;
+            return;
+        }
+
+        count_torus_channel(outport, input_unit->get_vc_classes(invc));
+    }
+
+    // remove flit from Input VC, unless this is not the last branch of a
+    // multicast packet: then send a copy down the branch and keep the flit
+    flit *t_flit;
+    bool replicated = !input_unit->is_last_branch(invc);
+    if (replicated) {
+        t_flit = input_unit->peekTopFlit(invc)->replicate(
+            m_router->get_flit_pool(), input_unit->get_branch_route(invc));
+        m_multicast_replications++;
+    } else {
+        t_flit = input_unit->getTopFlit(invc);
+        if (input_unit->has_branches(invc) &&
+            input_unit->get_branch_route(invc)) {
+            t_flit->set_route(input_unit->get_branch_route(invc));
+        }
+    }
+
+    DPRINTF(RubyNetwork, "SwitchAllocator at Router %d "
+                         "granted outvc %d at outport %d "
+                         "to invc %d at inport %d to flit %s at "
+                         "cycle: %lld\n",
+            m_router->get_id(), outvc,
+            m_router->getPortDirectionName(
+                output_unit->get_direction()),
+            invc,
+            m_router->getPortDirectionName(
+                input_unit->get_direction()),
+                *t_flit,
+            m_router->curCycle());
+
+
+    // Update outport field in the flit since this is
+    // used by CrossbarSwitch code to send it out of
+    // correct outport.
+    // Note: post route compute in InputUnit,
+    // outport is updated in VC, but not in flit
+    if (wormhole) {assert(t_flit->get_outport() == outport);}
+    else {t_flit->set_outport(outport);}
+
+    // set outvc (i.e., invc for next hop) in flit
+    // (This was updated in VC by vc_allocate, but not in flit)
+    t_flit->set_vc(outvc);
+
+    // Lookahead routing: compute the route at the next router while the
+    // flit traverses the switch and the link
+    if (m_lookahead &&
+        (t_flit->get_type() == HEAD_ || t_flit->get_type() == HEAD_TAIL_)) {
+        output_unit->lookahead_route(t_flit);
+    }
+
+    // decrement credit in outvc
+    output_unit->decrement_credit(outvc);
+    if (t_flit->get_type() == TAIL_ || t_flit->get_type() == HEAD_TAIL_)
+        output_unit->tail_sent(outvc);
+
+    // flit ready for Switch Traversal
+    t_flit->advance_stage(ST_, curTick());
+    m_router->grant_switch(inport, t_flit);
+    m_output_arbiter_activity++;
+
+    // The next flit, or the next copy of this one, goes down the next
+    // branch of the multicast packet
+    if (input_unit->has_branches(invc))
+        input_unit->next_branch(invc);
+
+    if (replicated) {
+        // The flit stays in the Input VC, no credit to send back
+    } else if (!wormhole) {
+        if ((t_flit->get_type() == TAIL_) ||
+            t_flit->get_type() == HEAD_TAIL_) {
+
+            if (input_unit->isEmpty(invc)) {
+                // Free this VC
+                input_unit->set_vc_idle(invc, curTick());
+            } else {
+                // Virtual cut-through: the next packet arrived behind
+                // this one and now takes the VC
+                assert(m_virtual_cut_through);
+                input_unit->next_packet(invc);
+            }
+
+            // Send a credit back
+            // along with the information that the packet left this VC
+            input_unit->increment_credit(invc, true, curTick());
+        } else {
+            // Send a credit back
+            // but do not indicate that the VC is idle
+            input_unit->increment_credit(invc, false, curTick());
+        }
+    } else {
+        if (!(input_unit->isReady(invc, curTick()))) {
+            // This Input VC is now empty
+            // Free this VC
+            input_unit->set_vc_idle(invc, curTick());
+
+            // Send a credit back
+            // along with the information that this VC is now idle
+            input_unit->increment_credit(invc, true, curTick());
+        } else {
+            // Send a credit back
+            // but do not indicate that the VC is idle
+            input_unit->increment_credit(invc, false, curTick());
+        }
+    }
+
+    // remove this request
+    m_port_requests[inport] = -1;
+
+    // Update Round Robin pointer to the next VC
+    // We do it here to keep it fair.
+    // Only the VC which got switch traversal
+    // is updated.
+    m_round_robin_invc[inport] = invc + 1;
+    if (m_round_robin_invc[inport] >= m_num_vcs)
+        m_round_robin_invc[inport] = 0;
+}
+
+/*
+ * Builds the request matrix of the matching policies. Every ready input
+ * VC that is allowed to be sent (same conditions as in SA-I) requests its
+ * output port; when several VCs of an input port request the same output
+ * port, the first one in round robin order places the request.
+ */
+
+void
+SwitchAllocator::collect_requests()
+{
+    bool wormhole = m_router->get_net_ptr()->isWormholeEnabled();
+    bool torus = (m_router->get_net_ptr()->getRoutingAlgorithm() == XYZ_);
+
+    std::fill(m_outport_requests.begin(), m_outport_requests.end(), 0);
+    for (int inport = 0; inport < m_num_inports; inport++) {
+        auto input_unit = m_router->getInputUnit(inport);
+        m_inport_requests[inport] = 0;
+
+        int rr_invc = m_round_robin_invc[inport];
+        uint64_t vcs = rotateRight(input_unit->get_sa_ready_vcs(curTick()),
+                                   rr_invc, m_num_vcs);
+
+        for (; vcs; vcs &= vcs - 1) {
+            int invc = rr_invc + ctz64(vcs);
+            if (invc >= m_num_vcs)
+                invc -= m_num_vcs;
+
+            int outport;
+            bool speculative;
+            if (!sa_request(inport, invc, wormhole, torus, outport,
+                            speculative))
+                continue;
+
+            uint64_t outport_bit = (uint64_t)1 << outport;
+            if (m_inport_requests[inport] & outport_bit)
+                continue;
+            m_inport_requests[inport] |= outport_bit;
+            m_outport_requests[outport] |= (uint64_t)1 << inport;
+            m_request_vcs[inport][outport] = invc;
+        }
+
+        if (m_inport_requests[inport])
+            m_input_arbiter_activity++;
+    }
+}
+
+void
+SwitchAllocator::add_match(int inport, int outport)
+{
+    m_port_requests[inport] = outport;
+    m_vc_winners[inport] = m_request_vcs[inport][outport];
+}
+
+/*
+ * iSLIP: in each iteration, every unmatched output port grants the
+ * requesting unmatched input port next to its round robin pointer, and
+ * every input port accepts the granting output port next to its own
+ * pointer. The pointers move past the matched port only in the first
+ * iteration, which keeps the allocator free of starvation.
+ */
+
+void
+SwitchAllocator::match_islip()
+{
+    uint64_t free_inports = mask(m_num_inports);
+    uint64_t free_outports = mask(m_num_outports);
+
+    for (int iter = 0; iter < m_iterations; iter++) {
+        // Grant
+        for (uint64_t outports = free_outports; outports;
+             outports &= outports - 1) {
+            int outport = ctz64(outports);
+            uint64_t inports = m_outport_requests[outport] & free_inports;
+            if (!inports)
+                continue;
+            int inport = rrSelect(inports, m_round_robin_inport[outport],
+                                  m_num_inports);
+            m_inport_grants[inport] |= (uint64_t)1 << outport;
+        }
+
+        // Accept
+        bool matched = false;
+        for (int inport = 0; inport < m_num_inports; inport++) {
+            uint64_t outports = m_inport_grants[inport];
+            if (!outports)
+                continue;
+            m_inport_grants[inport] = 0;
+
+            int outport = rrSelect(outports, m_round_robin_outport[inport],
+                                   m_num_outports);
+            add_match(inport, outport);
+            free_inports &= ~((uint64_t)1 << inport);
+            free_outports &= ~((uint64_t)1 << outport);
+            matched = true;
+
+            if (iter == 0) {
                 m_round_robin_inport[outport] = inport + 1;
                 if (m_round_robin_inport[outport] >= m_num_inports)
                     m_round_robin_inport[outport] = 0;
 
-                // Update Round Robin pointer to the next VC
-                // We do it here to keep it fair.
-                // Only the VC which got switch traversal
-                // is updated.
-                m_round_robin_invc[inport] = invc + 1;
-                if (m_round_robin_invc[inport] >= m_num_vcs)
-                    m_round_robin_invc[inport] = 0;
+                m_round_robin_outport[inport] = outport + 1;
+                if (m_round_robin_outport[inport] >= m_num_outports)
+                    m_round_robin_outport[inport] = 0;
+            }
+        }
 
+        if (!matched)
+            break;
+    }
+}
 
-                break; // got a input winner for this outport
-            }
+/*
+ * Wavefront: the cells (inport, outport) with inport + outport = d
+ * (mod n) form a diagonal in which no two cells share an input or an
+ * output port, so all their requests can be granted together. The
+ * diagonals are swept starting from the priority diagonal, which moves
+ * by one every cycle. It is derived from the cycle number, so cycles in
+ * which the router skips SA still move it.
+ */
 
-            inport++;
-            if (inport >= m_num_inports)
-                inport = 0;
+void
+SwitchAllocator::match_wavefront()
+{
+    int n = std::max(m_num_inports, m_num_outports);
+    uint64_t free_inports = mask(m_num_inports);
+    uint64_t free_outports = mask(m_num_outports);
+    int priority_diagonal = m_router->curCycle() % n;
+
+    for (int wave = 0; wave < n; wave++) {
+        int diagonal = priority_diagonal + wave;
+        if (diagonal >= n)
+            diagonal -= n;
+
+        for (int inport = 0; inport < m_num_inports; inport++) {
+            int outport = diagonal - inport;
+            if (outport < 0)
+                outport += n;
+            if (outport >= m_num_outports)
+                continue;
+
+            uint64_t inport_bit = (uint64_t)1 << inport;
+            uint64_t outport_bit = (uint64_t)1 << outport;
+            if ((m_inport_requests[inport] & outport_bit) &&
+                (free_inports & inport_bit) &&
+                (free_outports & outport_bit)) {
+                add_match(inport, outport);
+                free_inports &= ~inport_bit;
+                free_outports &= ~outport_bit;
+            }
         }
     }
 }
 
+/*
+ * Separable input-first allocation with least-recently-served matrix
+ * arbiters: each input port bids for the requested output port it
+ * served least recently, and each output port grants the bidding input
+ * port it served least recently. Only granted bids update the arbiters.
+ */
+
+void
+SwitchAllocator::match_matrix()
+{
+    for (int inport = 0; inport < m_num_inports; inport++) {
+        if (!m_inport_requests[inport])
+            continue;
+        int outport = lrsSelect(m_inport_lrs[inport],
+                                m_inport_requests[inport]);
+        m_outport_bids[outport] |= (uint64_t)1 << inport;
+    }
+
+    for (int outport = 0; outport < m_num_outports; outport++) {
+        uint64_t inports = m_outport_bids[outport];
+        if (!inports)
+            continue;
+        m_outport_bids[outport] = 0;
+
+        int inport = lrsSelect(m_outport_lrs[outport], inports);
+        add_match(inport, outport);
+        lrsUpdate(m_outport_lrs[outport], inport);
+        lrsUpdate(m_inport_lrs[inport], outport);
+    }
+}
+
+// Send the flits of the matched input ports through the switch.
+void
+SwitchAllocator::grant_matches()
+{
+    bool wormhole = m_router->get_net_ptr()->isWormholeEnabled();
+
+    for (int inport = 0; inport < m_num_inports; inport++) {
+        int outport = m_port_requests[inport];
+        if (outport != -1)
+            sa_grant(inport, outport, wormhole);
+    }
+}
+
 /*
  * A flit can be sent only if
  * (1) there is at least one free output VC at the
@@ -331,7 +816,8 @@ SwitchAllocator::arbitrate_outports()
  */
 
 bool
-SwitchAllocator::send_allowed(int inport, int invc, int outport, int outvc, bool wormhole, int first_half)
+SwitchAllocator::send_allowed(int inport, int invc, int outport, int outvc,
+                              bool wormhole, VcClassMask vc_classes)
 {
     // Check if outvc needed
     // Check if credit needed (for multi-flit packet)
@@ -347,24 +833,12 @@ SwitchAllocator::send_allowed(int inport, int invc, int outport, int outvc, bool
         if (!has_outvc) {
             // needs outvc
             // this is only true for HEAD and HEAD_TAIL flits.
-            if (first_half == 1) {
-                if (output_unit->first_has_free_vc(vnet)) {
-                    has_outvc = true;
-                    has_credit = true;
-                }
-            } else if (first_half == 0) {
-                if (output_unit->second_has_free_vc(vnet)) {
-                    has_outvc = true;
-                    has_credit = true;
-                }
-            } else {
-                assert(first_half == -1);
-                if (output_unit->has_free_vc(vnet)) {
-                    has_outvc = true;
-                    // each VC has at least one buffer,
-                    // so no need for additional credit check
-                    has_credit = true;
-                }
+            if (output_unit->has_free_vc(vnet, vc_classes,
+                                         head_min_credits(inport, invc))) {
+                has_outvc = true;
+                // each VC has at least one buffer,
+                // so no need for additional credit check
+                has_credit = true;
             }
         } else {
             has_credit = output_unit->has_credit(outvc);
@@ -386,6 +860,33 @@ SwitchAllocator::send_allowed(int inport, int invc, int outport, int outvc, bool
 
 
     // protocol ordering check
+    return order_allowed(inport, invc, outport);
+}
+
+// A multicast head flit can be sent only if every branch has a free
+// output VC and is allowed by ordering (see allocate_branch_vcs).
+bool
+SwitchAllocator::branches_allowed(int inport, int invc)
+{
+    auto input_unit = m_router->getInputUnit(inport);
+    int vnet = get_vnet(invc);
+    int min_credits = head_min_credits(inport, invc);
+    for (const MulticastBranch &branch : input_unit->get_branches(invc)) {
+        auto output_unit = m_router->getOutputUnit(branch.outport);
+        if (!output_unit->has_free_vc(vnet, branch.vc_classes,
+                                      min_credits) ||
+            !order_allowed(inport, invc, branch.outport)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Condition (3) above: pt-to-pt ordering in ordered vnets.
+bool
+SwitchAllocator::order_allowed(int inport, int invc, int outport)
+{
+    int vnet = get_vnet(invc);
     if ((m_router->get_net_ptr())->isVNetOrdered(vnet)) {
         auto input_unit = m_router->getInputUnit(inport);
 
@@ -395,10 +896,11 @@ SwitchAllocator::send_allowed(int inport, int invc, int outport, int outvc, bool
         // check if any other flit is ready for SA and for same output port
         // and was enqueued before this flit
         int vc_base = vnet*m_vc_per_vnet;
-        for (int vc_offset = 0; vc_offset < m_vc_per_vnet; vc_offset++) {
-            int temp_vc = vc_base + vc_offset;
-            if (input_unit->need_stage(temp_vc, SA_, curTick()) &&
-               (input_unit->get_outport(temp_vc) == outport) &&
+        uint64_t vcs = input_unit->get_sa_ready_vcs(curTick()) &
+                       (mask(m_vc_per_vnet) << vc_base);
+        for (; vcs; vcs &= vcs - 1) {
+            int temp_vc = ctz64(vcs);
+            if ((input_unit->get_outport(temp_vc) == outport) &&
                (input_unit->get_enqueue_time(temp_vc) < t_enqueue_time)) {
                 return false;
             }
@@ -408,59 +910,226 @@ SwitchAllocator::send_allowed(int inport, int invc, int outport, int outvc, bool
     return true;
 }
 
+// With speculative set, the candidates are only checked for ordering
+// (see sa_request).
 bool
-SwitchAllocator::torus_send_allowed(int inport, int invc, std::set<std::pair<int, bool>> outports)
+SwitchAllocator::torus_send_allowed(int inport, int invc,
+                                    const OutportCandidates &outports,
+                                    bool speculative)
 {
     assert(outports.size() > 0 && outports.size() <= 4);
-    std::set<std::pair<int, bool>> legal_outports;
-    for(auto& outport_firsthalf : outports) {
-        int outport = outport_firsthalf.first;
-        int first_half = (outport_firsthalf.second) ? 1 : 0;
-        if (send_allowed(inport, invc, outport, -1, false, first_half)) {
-                legal_outports.emplace(outport, first_half);
+    OutportCandidates legal_outports;
+    for (int i = 0; i < outports.size(); i++) {
+        int outport = outports.get_outport(i);
+        VcClassMask vc_classes = outports.get_vc_classes(i);
+        if (speculative ? order_allowed(inport, invc, outport) :
+            send_allowed(inport, invc, outport, -1, false, vc_classes)) {
+            legal_outports.add(outport, vc_classes);
         }
-
     }
-    if (legal_outports.size() == 0) {
+    if (legal_outports.empty()) {
         return false;
     }
-    // Randomly select a (outport, first_half) from `legal_outports`
-    int random_index = rand() % (legal_outports.size());
-    assert(random_index < legal_outports.size());
-    auto it = legal_outports.begin();
-    while (random_index > 0) {it++; assert(it != legal_outports.end()); random_index--;}
+    // Select a (outport, vc_classes) from `legal_outports`
+    int index = select_torus_candidate(invc, legal_outports);
     auto input_unit = m_router->getInputUnit(inport);
-    input_unit->grant_outport(invc, it->first);
-    input_unit->grant_firsthalf(invc, it->second);
+    input_unit->grant_outport(invc, legal_outports.get_outport(index));
+    input_unit->grant_vc_classes(invc,
+                                 legal_outports.get_vc_classes(index));
     return true;
+}
+
+// Index of the selected candidate among the legal outports of a 3D torus
+// head flit: uniformly at random, or the least congested candidate with
+// ties broken at random.
+int
+SwitchAllocator::select_torus_candidate(int invc,
+                                        const OutportCandidates &outports)
+{
+    if (m_torus_selection == GarnetTorusSelection::random)
+        return m_router->get_rng().random(outports.size());
+
+    int vnet = get_vnet(invc);
+    int best_score = -1;
+    int best[OutportCandidates::MAX_CANDIDATES];
+    int num_best = 0;
+    for (int i = 0; i < outports.size(); i++) {
+        int score = torus_candidate_score(vnet, outports.get_outport(i),
+                                          outports.get_vc_classes(i));
+        if (score > best_score) {
+            best_score = score;
+            num_best = 0;
+        }
+        if (score == best_score)
+            best[num_best++] = i;
+    }
+    return (num_best == 1) ? best[0]
+                           : best[m_router->get_rng().random(num_best)];
+}
+
+// Congestion score of a torus candidate, higher is less congested
+int
+SwitchAllocator::torus_candidate_score(int vnet, int outport,
+                                       VcClassMask vc_classes)
+{
+    auto output_unit = m_router->getOutputUnit(outport);
+    switch (m_torus_selection) {
+      case GarnetTorusSelection::free_vcs:
+        return output_unit->count_free_vcs(vnet, vc_classes);
+      case GarnetTorusSelection::credits:
+        return output_unit->count_credits(vnet, vc_classes);
+      case GarnetTorusSelection::regional: {
+        // Credits at this router plus at the next one in the same
+        // direction, which the packet is likely to take again
+        int score = output_unit->count_credits(vnet, vc_classes);
+        if (m_regional_outports[outport]) {
+            score += m_regional_outports[outport]->count_credits(
+                vnet, ALL_VC_CLASSES_);
+        }
+        return score;
+      }
+      default:
+        panic("Unknown torus selection function");
+    }
+}
+
+// Credits the output VC of the head flit waiting at (inport, invc) needs:
+// room for the whole packet with virtual cut-through, one flit otherwise.
+int
+SwitchAllocator::head_min_credits(int inport, int invc)
+{
+    if (!m_virtual_cut_through)
+        return 1;
 
+    flit *t_flit = m_router->getInputUnit(inport)->peekTopFlit(invc);
+    assert(t_flit->get_type() == HEAD_ || t_flit->get_type() == HEAD_TAIL_);
+    return t_flit->get_size();
 }
 
-// Assign a free VC to the winner of the output port.
+// Assign a free VC to the winner of the output port, from the VC classes
+// its routing allows.
 int
-SwitchAllocator::vc_allocate(int outport, int inport, int invc, bool wormhole, int firsthalf)
+SwitchAllocator::vc_allocate(int outport, int inport, int invc, bool wormhole)
 {
     int outvc;
     if (!wormhole) {
         // Select a free VC from the output port
-        if (firsthalf == 1) {
-            outvc = m_router->getOutputUnit(outport)->first_select_free_vc(get_vnet(invc));
-        } else if (firsthalf == 0) {
-            outvc = m_router->getOutputUnit(outport)->second_select_free_vc(get_vnet(invc));
-        } else {
-            assert(firsthalf == -1);
-            outvc = m_router->getOutputUnit(outport)->select_free_vc(get_vnet(invc));
-        }
+        VcClassMask vc_classes =
+            m_router->getInputUnit(inport)->get_vc_classes(invc);
+        outvc = m_router->getOutputUnit(outport)->select_free_vc(
+            get_vnet(invc), vc_classes, head_min_credits(inport, invc));
     } else {
         // Select a VC with credits from the output port
         outvc = m_router->getOutputUnit(outport)->select_vc_with_credits(get_vnet(invc));
     }
-    // has to get a valid VC since it checked before performing SA
-    assert(outvc != -1);
+    // It checked for a VC before performing SA, but with speculative SA
+    // other head flits compete for the VC, and a multicast head flit may
+    // have taken it (see sa_grant)
+    if (outvc == -1)
+        return -1;
     m_router->getInputUnit(inport)->grant_outvc(invc, outvc);
     return outvc;
 }
 
+/*
+ * VC allocation of speculative SA, run between the two stages of SA:
+ * every HEAD/HEAD_TAIL flit in SA stage without an output VC, requesting
+ * the switch or not, competes for a free VC at its output port. The
+ * input ports, and the VCs of each input port, are served in round robin
+ * order, and the flits are granted free VCs until there are none left.
+ * A flit keeps its VC when it loses SA, and requests the switch
+ * non-speculatively from the next cycle. Multicast head flits allocate
+ * the VCs of all their branches when they win SA instead.
+ */
+
+void
+SwitchAllocator::allocate_vcs()
+{
+    for (int i = 0; i < m_num_inports; i++) {
+        int inport = m_round_robin_va + i;
+        if (inport >= m_num_inports)
+            inport -= m_num_inports;
+        auto input_unit = m_router->getInputUnit(inport);
+
+        int rr_invc = m_round_robin_invc[inport];
+        uint64_t vcs = rotateRight(input_unit->get_sa_ready_vcs(curTick()),
+                                   rr_invc, m_num_vcs);
+        for (; vcs; vcs &= vcs - 1) {
+            int invc = rr_invc + ctz64(vcs);
+            if (invc >= m_num_vcs)
+                invc -= m_num_vcs;
+
+            // A 3D torus head flit has no outport until it has selected
+            // one of its candidates in SA-I
+            int outport = input_unit->get_outport(invc);
+            if (input_unit->get_outvc(invc) != -1 || outport == -1 ||
+                input_unit->has_branches(invc)) {
+                continue;
+            }
+
+            if (vc_allocate(outport, inport, invc, false) != -1) {
+                count_torus_channel(outport,
+                                    input_unit->get_vc_classes(invc));
+            }
+        }
+    }
+
+    m_round_robin_va++;
+    if (m_round_robin_va >= m_num_inports)
+        m_round_robin_va = 0;
+}
+
+/*
+ * Allocate the output VCs of all the branches of the multicast head flit
+ * at (inport, invc), or of none of them. The packet then owns a VC on
+ * every branch before its head leaves on the first one. A packet holding
+ * the VCs of some branches while it waits for the others could deadlock
+ * with another multicast packet holding the rest.
+ */
+
+bool
+SwitchAllocator::allocate_branch_vcs(int inport, int invc)
+{
+    auto input_unit = m_router->getInputUnit(inport);
+    const std::vector<MulticastBranch> &branches =
+        input_unit->get_branches(invc);
+    int vnet = get_vnet(invc);
+    int min_credits = head_min_credits(inport, invc);
+
+    for (int i = 0; i < branches.size(); i++) {
+        int outvc = m_router->getOutputUnit(branches[i].outport)->
+            select_free_vc(vnet, branches[i].vc_classes, min_credits);
+        if (outvc == -1) {
+            // Give back the VCs of the previous branches
+            for (int j = 0; j < i; j++) {
+                m_router->getOutputUnit(branches[j].outport)->
+                    release_vc(branches[j].outvc);
+                input_unit->grant_branch_outvc(invc, j, -1);
+            }
+            return false;
+        }
+        input_unit->grant_branch_outvc(invc, i, outvc);
+    }
+
+    for (const MulticastBranch &branch : branches)
+        count_torus_channel(branch.outport, branch.vc_classes);
+    return true;
+}
+
+// Count an output VC allocated at a 3D torus outport in the channel
+// class of its VC classes: R1 channels use the adaptive VC class, R2 the
+// escape class
+void
+SwitchAllocator::count_torus_channel(int outport, VcClassMask vc_classes)
+{
+    if (m_torus_channels[outport] == -1)
+        return;
+
+    VcClassMask r1 = vcClassBit(GarnetVcClass::adaptive);
+    int channel = m_torus_channels[outport] + ((vc_classes & r1) ? 0 : 1);
+    m_torus_channel_selections[channel]++;
+}
+
 // Wakeup the router next cycle to perform SA again
 // if there are flits ready.
 void
@@ -473,11 +1142,9 @@ SwitchAllocator::check_for_wakeup()
     }
 
     for (int i = 0; i < m_num_inports; i++) {
-        for (int j = 0; j < m_num_vcs; j++) {
-            if (m_router->getInputUnit(i)->need_stage(j, SA_, nextCycle)) {
-                m_router->schedule_wakeup(Cycles(1));
-                return;
-            }
+        if (m_router->getInputUnit(i)->get_sa_ready_vcs(nextCycle)) {
+            m_router->schedule_wakeup(Cycles(1));
+            return;
         }
     }
 }
@@ -497,6 +1164,8 @@ void
 SwitchAllocator::clear_request_vector()
 {
     std::fill(m_port_requests.begin(), m_port_requests.end(), -1);
+    std::fill(m_speculative_requests.begin(), m_speculative_requests.end(),
+              false);
 }
 
 void
@@ -504,6 +1173,10 @@ SwitchAllocator::resetStats()
 {
     m_input_arbiter_activity = 0;
     m_output_arbiter_activity = 0;
+    m_failed_speculations = 0;
+    m_multicast_replications = 0;
+    std::fill(std::begin(m_torus_channel_selections),
+              std::end(m_torus_channel_selections), 0);
 }
 
 } // namespace garnet
@@ -35,6 +35,8 @@
 #include <iostream>
 #include <vector>
 
+#include "enums/GarnetSAPolicy.hh"
+#include "enums/GarnetTorusSelection.hh"
 #include "mem/ruby/common/Consumer.hh"
 #include "mem/ruby/network/garnet/CommonTypes.hh"
 
@@ -63,9 +65,21 @@ class SwitchAllocator : public Consumer
     void print(std::ostream& out) const {};
     void arbitrate_inports();
     void arbitrate_outports();
-    bool send_allowed(int inport, int invc, int outport, int outvc, bool wormhole, int first_half);
-    bool torus_send_allowed(int inport, int invc, std::set<std::pair<int, bool>>);
-    int vc_allocate(int outport, int inport, int invc, bool wormhole, int firsthalf);
+    void collect_requests();
+    void match_islip();
+    void match_wavefront();
+    void match_matrix();
+    void grant_matches();
+    bool send_allowed(int inport, int invc, int outport, int outvc,
+                      bool wormhole, VcClassMask vc_classes);
+    bool order_allowed(int inport, int invc, int outport);
+    bool branches_allowed(int inport, int invc);
+    bool torus_send_allowed(int inport, int invc,
+                            const OutportCandidates &outports,
+                            bool speculative);
+    int vc_allocate(int outport, int inport, int invc, bool wormhole);
+    bool allocate_branch_vcs(int inport, int invc);
+    void allocate_vcs();
 
     inline double
     get_input_arbiter_activity()
@@ -77,20 +91,81 @@ class SwitchAllocator : public Consumer
     {
         return m_output_arbiter_activity;
     }
+    inline double
+    get_failed_speculations()
+    {
+        return m_failed_speculations;
+    }
+    inline double
+    get_multicast_replications()
+    {
+        return m_multicast_replications;
+    }
+    inline double
+    get_torus_channel_selections(int channel)
+    {
+        return m_torus_channel_selections[channel];
+    }
 
     void resetStats();
 
   private:
+    int head_min_credits(int inport, int invc);
+    bool sa_request(int inport, int invc, bool wormhole, bool torus,
+                    int &outport, bool &speculative);
+    void sa_grant(int inport, int outport, bool wormhole);
+    void add_match(int inport, int outport);
+    void count_torus_channel(int outport, VcClassMask vc_classes);
+    int select_torus_candidate(int invc,
+                               const OutportCandidates &outports);
+    int torus_candidate_score(int vnet, int outport,
+                              VcClassMask vc_classes);
+
     int m_num_inports, m_num_outports;
     int m_num_vcs, m_vc_per_vnet;
+    GarnetSAPolicy m_policy;
+    int m_iterations;
+    bool m_lookahead, m_speculative;
+    bool m_virtual_cut_through;
 
     double m_input_arbiter_activity, m_output_arbiter_activity;
+    double m_failed_speculations;
+    double m_multicast_replications;
+    double m_torus_channel_selections[NUM_CHANNEL_TYPES_];
 
     Router *m_router;
     std::vector<int> m_round_robin_invc;
     std::vector<int> m_round_robin_inport;
     std::vector<int> m_port_requests;
     std::vector<int> m_vc_winners;
+    std::vector<bool> m_speculative_requests;
+    // Input port served first by the VC allocation of speculative SA
+    int m_round_robin_va;
+
+    // 3D torus output selection: R1 channel class of each outport (-1 if
+    // not a torus direction) and, for the regional selection, the outport
+    // in the same direction at the next router.
+    GarnetTorusSelection m_torus_selection;
+    std::vector<int> m_torus_channels;
+    std::vector<OutputUnit *> m_regional_outports;
+
+    // Request matrix of the matching policies (all but separable):
+    // outports requested by each inport, inports requesting each outport,
+    // and the input VC placing the request of each (inport, outport).
+    std::vector<uint64_t> m_inport_requests;
+    std::vector<uint64_t> m_outport_requests;
+    std::vector<std::vector<int>> m_request_vcs;
+
+    // iSLIP accept pointers and grants; the grant pointers are
+    // m_round_robin_inport.
+    std::vector<int> m_round_robin_outport;
+    std::vector<uint64_t> m_inport_grants;
+
+    // Least-recently-served matrix arbiters of the input and output ports
+    // and the bids of the input ports to each output port.
+    std::vector<std::vector<uint64_t>> m_inport_lrs;
+    std::vector<std::vector<uint64_t>> m_outport_lrs;
+    std::vector<uint64_t> m_outport_bids;
 };
 
 } // namespace garnet
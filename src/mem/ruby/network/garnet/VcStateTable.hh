@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2026 The gem5 contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __MEM_RUBY_NETWORK_GARNET_0_VCSTATETABLE_HH__
+#define __MEM_RUBY_NETWORK_GARNET_0_VCSTATETABLE_HH__
+
+#include <vector>
+
+#include "mem/ruby/network/garnet/CommonTypes.hh"
+
+namespace gem5
+{
+
+namespace ruby
+{
+
+namespace garnet
+{
+
+// Scalar state of all the VCs of a router, kept as one array per field
+// so that allocation walks a few contiguous cache lines instead of one
+// object per VC. The input VCs of a port, and the output VCs (i.e., the
+// input VCs of the next router) of a port, are consecutive entries from
+// the base index returned when the port is added.
+struct VcStateTable
+{
+    // Input VCs
+    std::vector<VC_state_type> in_state;
+    std::vector<Tick> in_state_time;
+    std::vector<int> in_outport;
+    std::vector<int> in_outvc;
+    std::vector<Tick> in_enqueue_time;
+
+    // Output VCs
+    std::vector<VC_state_type> out_state;
+    // Time the state was entered, e.g., the tick from which an idle VC
+    // can be allocated
+    std::vector<Tick> out_state_time;
+    std::vector<int> out_credits;
+    std::vector<int> out_max_credits;
+    // Packets sent on the VC that have not left the next router yet
+    // (i.e., whose free signal has not come back). With virtual
+    // cut-through, a VC takes a packet once the previous one was sent.
+    std::vector<int> out_packets;
+
+    int
+    add_input_vcs(int num_vcs)
+    {
+        int base = in_state.size();
+        in_state.resize(base + num_vcs, IDLE_);
+        in_state_time.resize(base + num_vcs, 0);
+        in_outport.resize(base + num_vcs, -1);
+        in_outvc.resize(base + num_vcs, -1);
+        in_enqueue_time.resize(base + num_vcs, INFINITE_);
+        return base;
+    }
+
+    // max_credits holds the depth of each VC at the next router
+    int
+    add_output_vcs(const std::vector<int> &max_credits)
+    {
+        int base = out_state.size();
+        int num_vcs = max_credits.size();
+        out_state.resize(base + num_vcs, IDLE_);
+        out_state_time.resize(base + num_vcs, 0);
+        out_credits.insert(out_credits.end(), max_credits.begin(),
+                           max_credits.end());
+        out_max_credits.insert(out_max_credits.end(), max_credits.begin(),
+                               max_credits.end());
+        out_packets.resize(base + num_vcs, 0);
+        return base;
+    }
+};
+
+} // namespace garnet
+} // namespace ruby
+} // namespace gem5
+
+#endif // __MEM_RUBY_NETWORK_GARNET_0_VCSTATETABLE_HH__
@@ -40,9 +40,10 @@ namespace ruby
 namespace garnet
 {
 
-VirtualChannel::VirtualChannel()
-  : inputBuffer(), m_vc_state(IDLE_, Tick(0)), m_output_port(-1),
-    m_enqueue_time(INFINITE_), m_output_vc(-1), m_first_half_vcs(true)
+VirtualChannel::VirtualChannel(int buffer_size, VcStateTable *table,
+                               int index)
+  : inputBuffer(buffer_size), m_table(table), m_index(index),
+    m_vc_classes(ALL_VC_CLASSES_), m_branch(0)
 {
     clear_outports();
 }
@@ -50,28 +51,77 @@ VirtualChannel::VirtualChannel()
 void
 VirtualChannel::set_idle(Tick curTime)
 {
-    m_vc_state.first = IDLE_;
-    m_vc_state.second = curTime;
-    m_enqueue_time = Tick(INFINITE_);
-    m_output_port = -1;
-    m_output_vc = -1;
+    set_state(IDLE_, curTime);
+    clear_route();
+}
+
+// Virtual cut-through: the next packet in the VC, which entered it at
+// enqueue_time, takes the VC over from the packet that just left
+void
+VirtualChannel::next_packet(Tick enqueue_time)
+{
+    assert(get_state() == ACTIVE_);
+    clear_route();
+    set_enqueue_time(enqueue_time);
+}
+
+void
+VirtualChannel::clear_route()
+{
+    set_enqueue_time(Tick(INFINITE_));
+    set_outport(-1);
+    set_outvc(-1);
     clear_outports();
-    m_first_half_vcs = true;
+    m_vc_classes = ALL_VC_CLASSES_;
+    m_branches.clear();
+    m_branch = 0;
+}
+
+void
+VirtualChannel::set_branches(const std::vector<MulticastBranch> &branches)
+{
+    assert(!branches.empty() && m_branches.empty());
+    m_branches = branches;
+    m_branch = 0;
+    set_outport(m_branches[0].outport);
+    set_outvc(-1);
+    m_vc_classes = m_branches[0].vc_classes;
+}
+
+void
+VirtualChannel::set_branch_outvc(int branch, int outvc)
+{
+    assert(branch < m_branches.size());
+    m_branches[branch].outvc = outvc;
+    if (branch == m_branch)
+        set_outvc(outvc);
+}
+
+// Move on to the next branch, back to the first one after the last
+void
+VirtualChannel::next_branch()
+{
+    assert(!m_branches.empty());
+    m_branches[m_branch].outvc = get_outvc();
+    m_branch = (m_branch + 1) % m_branches.size();
+    set_outport(m_branches[m_branch].outport);
+    set_outvc(m_branches[m_branch].outvc);
+    m_vc_classes = m_branches[m_branch].vc_classes;
 }
 
 void
 VirtualChannel::set_active(Tick curTime)
 {
-    m_vc_state.first = ACTIVE_;
-    m_vc_state.second = curTime;
-    m_enqueue_time = curTime;
+    set_state(ACTIVE_, curTime);
+    set_enqueue_time(curTime);
 }
 
 bool
 VirtualChannel::need_stage(flit_stage stage, Tick time)
 {
     if (inputBuffer.isReady(time)) {
-        assert(m_vc_state.first == ACTIVE_ && m_vc_state.second <= time);
+        assert(get_state() == ACTIVE_ &&
+               m_table->in_state_time[m_index] <= time);
         flit *t_flit = inputBuffer.peekTopFlit();
         return(t_flit->is_stage(stage, time));
     }
@@ -33,9 +33,10 @@
 #define __MEM_RUBY_NETWORK_GARNET_0_VIRTUALCHANNEL_HH__
 
 #include <utility>
-#include <set>
+#include <vector>
 
 #include "mem/ruby/network/garnet/CommonTypes.hh"
+#include "mem/ruby/network/garnet/VcStateTable.hh"
 #include "mem/ruby/network/garnet/flitBuffer.hh"
 
 namespace gem5
@@ -47,30 +48,76 @@ namespace ruby
 namespace garnet
 {
 
+// Input VC of a router. Its buffer, 3D torus routing and multicast state
+// live here, its scalar state in entry m_index of the VC state table of
+// the router.
 class VirtualChannel
 {
   public:
-    VirtualChannel();
+    VirtualChannel(int buffer_size, VcStateTable *table, int index);
     ~VirtualChannel() = default;
 
     bool need_stage(flit_stage stage, Tick time);
     void set_idle(Tick curTime);
     void set_active(Tick curTime);
-    void set_outvc(int outvc)               { m_output_vc = outvc; }
-    inline int get_outvc()                  { return m_output_vc; }
-    void set_outport(int outport)           { m_output_port = outport; };
-    inline int get_outport()                  { return m_output_port; }
-    void clear_outports()                                              {m_output_ports.clear();}
-    std::set<std::pair<int, bool>> get_outports()                     {return m_output_ports;}
-    inline bool is_clear_outports()                                     {return m_output_ports.size() == 0;}
-    void set_outports(std::set<std::pair<int, bool>> outports)           {m_output_ports = outports;}
-    void set_first_half_vcs(bool first_half_vcs)                        {m_first_half_vcs = first_half_vcs;}
-    inline bool get_first_half_vcs()                                    {return m_first_half_vcs;}
-
-
-    inline Tick get_enqueue_time()          { return m_enqueue_time; }
-    inline void set_enqueue_time(Tick time) { m_enqueue_time = time; }
-    inline VC_state_type get_state()        { return m_vc_state.first; }
+    void next_packet(Tick enqueue_time);
+    void set_outvc(int outvc)       { m_table->in_outvc[m_index] = outvc; }
+    inline int get_outvc()          { return m_table->in_outvc[m_index]; }
+    void
+    set_outport(int outport)
+    {
+        m_table->in_outport[m_index] = outport;
+    }
+    inline int get_outport()        { return m_table->in_outport[m_index]; }
+    void clear_outports()                   { m_output_ports.clear(); }
+    const OutportCandidates &get_outports() { return m_output_ports; }
+    inline bool is_clear_outports()         { return m_output_ports.empty(); }
+    void
+    set_outports(const OutportCandidates &outports)
+    {
+        m_output_ports = outports;
+    }
+    void
+    set_vc_classes(VcClassMask vc_classes)
+    {
+        m_vc_classes = vc_classes;
+    }
+    inline VcClassMask get_vc_classes()     { return m_vc_classes; }
+
+    // Multicast branches, see m_branches
+    void set_branches(const std::vector<MulticastBranch> &branches);
+    void set_branch_outvc(int branch, int outvc);
+    void next_branch();
+    inline const std::vector<MulticastBranch> &
+    get_branches()
+    {
+        return m_branches;
+    }
+    inline bool
+    is_last_branch()
+    {
+        return m_branch + 1 >= (int)m_branches.size();
+    }
+    inline const RouteInfoPtr &
+    get_branch_route()
+    {
+        assert(!m_branches.empty());
+        return m_branches[m_branch].route;
+    }
+    inline bool has_branches()              { return !m_branches.empty(); }
+
+
+    inline Tick
+    get_enqueue_time()
+    {
+        return m_table->in_enqueue_time[m_index];
+    }
+    inline void
+    set_enqueue_time(Tick time)
+    {
+        m_table->in_enqueue_time[m_index] = time;
+    }
+    inline VC_state_type get_state() { return m_table->in_state[m_index]; }
 
     inline bool
     isReady(Tick curTime)
@@ -78,6 +125,8 @@ class VirtualChannel
         return inputBuffer.isReady(curTime);
     }
 
+    inline bool isEmpty()                   { return inputBuffer.isEmpty(); }
+
     inline void
     insertFlit(flit *t_flit)
     {
@@ -87,8 +136,8 @@ class VirtualChannel
     inline void
     set_state(VC_state_type m_state, Tick curTime)
     {
-        m_vc_state.first = m_state;
-        m_vc_state.second = curTime;
+        m_table->in_state[m_index] = m_state;
+        m_table->in_state_time[m_index] = curTime;
     }
 
     inline flit*
@@ -107,13 +156,24 @@ class VirtualChannel
     uint32_t functionalWrite(Packet *pkt);
 
   private:
+    void clear_route();
+
     flitBuffer inputBuffer;
-    std::pair<VC_state_type, Tick> m_vc_state;
-    int m_output_port;
-    Tick m_enqueue_time;
-    int m_output_vc;
-    std::set<std::pair<int, bool>> m_output_ports; // only used in 3d torus customed routing case, in InputUnit::wakeup()
-    bool m_first_half_vcs; // only used in 3d torus. true: first half vcs; false: second half vcs.
+    VcStateTable *m_table;
+    int m_index;
+    OutportCandidates m_output_ports; // only used in 3d torus customed routing case, in InputUnit::wakeup()
+    // Classes the output VC of the packet may be allocated from, set by
+    // adaptive routing (3D torus) when the outport is selected
+    VcClassMask m_vc_classes;
+
+    // Branches of a multicast packet, empty for unicast packets. The flit
+    // at the head of the VC is sent down each branch in turn, and only
+    // leaves the VC on the last one. The output VCs of all the branches
+    // are allocated together, before the head flit leaves on the first.
+    // Outport, output VC and VC classes of the VC are those of branch
+    // m_branch.
+    std::vector<MulticastBranch> m_branches;
+    int m_branch;
 };
 
 } // namespace garnet
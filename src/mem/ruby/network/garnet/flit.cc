@@ -43,19 +43,24 @@ namespace garnet
 {
 
 // Constructor for the flit
-flit::flit(int packet_id, int id, int  vc, int vnet, RouteInfo route, int size,
-    MsgPtr msg_ptr, int MsgSize, uint32_t bWidth, Tick curTime)
+flit::flit(int packet_id, int id, int  vc, int vnet,
+    const RouteInfoPtr &route, int size, MsgPtr msg_ptr, int MsgSize,
+    uint32_t bWidth, Tick curTime)
 {
     m_size = size;
     m_msg_ptr = msg_ptr;
     m_enqueue_time = curTime;
     m_dequeue_time = curTime;
     m_time = curTime;
-    m_packet_id = id;
+    m_packet_id = packet_id;
     m_id = id;
     m_vnet = vnet;
     m_vc = vc;
     m_route = route;
+    // initialize hops_traversed to -1
+    // so that the first router increments it to 0
+    m_hops_traversed = -1;
+    m_lookahead_outport = -1;
     m_stage.first = I_;
     m_stage.second = curTime;
     m_width = bWidth;
@@ -83,10 +88,12 @@ flit::serialize(int ser_id, int parts, uint32_t bWidth)
     int new_size = (int)divCeil((float)msgSize, (float)bWidth);
     assert(new_id < new_size);
 
-    flit *fl = new flit(m_packet_id, new_id, m_vc, m_vnet, m_route,
-                    new_size, m_msg_ptr, msgSize, bWidth, m_time);
+    flit *fl = new (*FlitPool::owner(this)) flit(m_packet_id, new_id, m_vc,
+                    m_vnet, m_route, new_size, m_msg_ptr, msgSize, bWidth,
+                    m_time);
     fl->set_enqueue_time(m_enqueue_time);
     fl->set_src_delay(src_delay);
+    fl->m_hops_traversed = m_hops_traversed;
     return fl;
 }
 
@@ -98,10 +105,24 @@ flit::deserialize(int des_id, int num_flits, uint32_t bWidth)
     int new_size = (int)divCeil((float)msgSize, (float)bWidth);
     assert(new_id < new_size);
 
-    flit *fl = new flit(m_packet_id, new_id, m_vc, m_vnet, m_route,
-                    new_size, m_msg_ptr, msgSize, bWidth, m_time);
+    flit *fl = new (*FlitPool::owner(this)) flit(m_packet_id, new_id, m_vc,
+                    m_vnet, m_route, new_size, m_msg_ptr, msgSize, bWidth,
+                    m_time);
     fl->set_enqueue_time(m_enqueue_time);
     fl->set_src_delay(src_delay);
+    fl->m_hops_traversed = m_hops_traversed;
+    return fl;
+}
+
+// Copy of this flit for another branch of a multicast packet
+flit *
+flit::replicate(FlitPool &pool, const RouteInfoPtr &route)
+{
+    flit *fl = new (pool) flit(m_packet_id, m_id, m_vc, m_vnet, route,
+                               m_size, m_msg_ptr, msgSize, m_width, m_time);
+    fl->set_enqueue_time(m_enqueue_time);
+    fl->set_src_delay(src_delay);
+    fl->m_hops_traversed = m_hops_traversed;
     return fl;
 }
 
@@ -116,10 +137,10 @@ flit::print(std::ostream& out) const
     out << "Size=" << m_size << " ";
     out << "Vnet=" << m_vnet << " ";
     out << "VC=" << m_vc << " ";
-    out << "Src NI=" << m_route.src_ni << " ";
-    out << "Src Router=" << m_route.src_router << " ";
-    out << "Dest NI=" << m_route.dest_ni << " ";
-    out << "Dest Router=" << m_route.dest_router << " ";
+    out << "Src NI=" << m_route->src_ni << " ";
+    out << "Src Router=" << m_route->src_router << " ";
+    out << "Dest NI=" << m_route->dest_ni << " ";
+    out << "Dest Router=" << m_route->dest_router << " ";
     out << "Set Time=" << m_time << " ";
     out << "Width=" << m_width<< " ";
     out << "]";
@@ -36,6 +36,7 @@
 
 #include "base/types.hh"
 #include "mem/ruby/network/garnet/CommonTypes.hh"
+#include "mem/ruby/network/garnet/FlitPool.hh"
 #include "mem/ruby/slicc_interface/Message.hh"
 
 namespace gem5
@@ -51,11 +52,26 @@ class flit
 {
   public:
     flit() {}
-    flit(int packet_id, int id, int vc, int vnet, RouteInfo route, int size,
-         MsgPtr msg_ptr, int MsgSize, uint32_t bWidth, Tick curTime);
+    flit(int packet_id, int id, int vc, int vnet, const RouteInfoPtr &route,
+         int size, MsgPtr msg_ptr, int MsgSize, uint32_t bWidth,
+         Tick curTime);
 
     virtual ~flit(){};
 
+    // Flits live in the FlitPool of their network: allocate them with
+    // new (pool) flit(...) and free them with delete.
+    static void *
+    operator new(std::size_t size, FlitPool &pool)
+    {
+        return pool.allocate(size);
+    }
+    static void operator delete(void *ptr) { FlitPool::release(ptr); }
+    static void
+    operator delete(void *ptr, FlitPool &pool)
+    {
+        FlitPool::release(ptr);
+    }
+
     int get_outport() {return m_outport; }
     int get_size() { return m_size; }
     Tick get_enqueue_time() { return m_enqueue_time; }
@@ -65,21 +81,44 @@ class flit
     Tick get_time() { return m_time; }
     int get_vnet() { return m_vnet; }
     int get_vc() { return m_vc; }
-    RouteInfo get_route() { return m_route; }
+    const RouteInfo &get_route() { return *m_route; }
+    const RouteInfoPtr &get_route_ptr() { return m_route; }
+    int get_hops_traversed() { return m_hops_traversed; }
     MsgPtr& get_msg_ptr() { return m_msg_ptr; }
     flit_type get_type() { return m_type; }
     std::pair<flit_stage, Tick> get_stage() { return m_stage; }
     Tick get_src_delay() { return src_delay; }
 
+    // Route of a head flit at the next router, computed one hop ahead
+    // with lookahead routing (-1 / empty when it was not computed)
+    int get_lookahead_outport() { return m_lookahead_outport; }
+    const OutportCandidates &
+    get_lookahead_outports()
+    {
+        return m_lookahead_outports;
+    }
+    void set_lookahead_outport(int port) { m_lookahead_outport = port; }
+    void
+    set_lookahead_outports(const OutportCandidates &outports)
+    {
+        m_lookahead_outports = outports;
+    }
+    void
+    clear_lookahead()
+    {
+        m_lookahead_outport = -1;
+        m_lookahead_outports.clear();
+    }
+
     void set_outport(int port) { m_outport = port; }
     void set_time(Tick time) { m_time = time; }
     void set_vc(int vc) { m_vc = vc; }
-    void set_route(RouteInfo route) { m_route = route; }
+    void set_route(const RouteInfoPtr &route) { m_route = route; }
     void set_src_delay(Tick delay) { src_delay = delay; }
     void set_dequeue_time(Tick time) { m_dequeue_time = time; }
     void set_enqueue_time(Tick time) { m_enqueue_time = time; }
 
-    void increment_hops() { m_route.hops_traversed++; }
+    void increment_hops() { m_hops_traversed++; }
     virtual void print(std::ostream& out) const;
 
     bool
@@ -112,6 +151,7 @@ class flit
 
     virtual flit* serialize(int ser_id, int parts, uint32_t bWidth);
     virtual flit* deserialize(int des_id, int num_flits, uint32_t bWidth);
+    flit *replicate(FlitPool &pool, const RouteInfoPtr &route);
 
     uint32_t m_width;
     int msgSize;
@@ -120,13 +160,16 @@ class flit
     int m_id;
     int m_vnet;
     int m_vc;
-    RouteInfo m_route;
+    RouteInfoPtr m_route;
+    int m_hops_traversed;
     int m_size;
     Tick m_enqueue_time, m_dequeue_time;
     Tick m_time;
     flit_type m_type;
     MsgPtr m_msg_ptr;
     int m_outport;
+    int m_lookahead_outport;
+    OutportCandidates m_lookahead_outports;
     Tick src_delay;
     std::pair<flit_stage, Tick> m_stage;
 };
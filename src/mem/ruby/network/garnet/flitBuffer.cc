@@ -31,6 +31,9 @@
 
 #include "mem/ruby/network/garnet/flitBuffer.hh"
 
+#include "base/intmath.hh"
+#include "base/logging.hh"
+
 namespace gem5
 {
 
@@ -40,26 +43,56 @@ namespace ruby
 namespace garnet
 {
 
+namespace
+{
+
+// Ring size of a buffer without maximum size before it first grows
+const int INITIAL_RING_SIZE = 4;
+
+} // anonymous namespace
+
 flitBuffer::flitBuffer()
+    : m_mask(0), m_head(0), m_tail(0), m_limit(0), max_size(INFINITE_)
 {
-    max_size = INFINITE_;
+    resize(INITIAL_RING_SIZE);
 }
 
 flitBuffer::flitBuffer(int maximum_size)
+    : m_mask(0), m_head(0), m_tail(0), m_limit(0), max_size(INFINITE_)
 {
-    max_size = maximum_size;
+    setMaxSize(maximum_size);
 }
 
-bool
-flitBuffer::isEmpty()
+// Move the flits to a ring of size entries, the next power of two
+void
+flitBuffer::resize(int size)
+{
+    size = 1 << ceilLog2(size);
+    assert(size >= getSize());
+
+    std::vector<flit *> ring(size, nullptr);
+    for (uint32_t i = m_head; i != m_tail; i++)
+        ring[i - m_head] = m_buffer[i & m_mask];
+
+    m_tail -= m_head;
+    m_head = 0;
+    m_buffer.swap(ring);
+    m_mask = size - 1;
+    m_limit = (max_size == INFINITE_) ? size : max_size;
+}
+
+void
+flitBuffer::makeRoom()
 {
-    return (m_buffer.size() == 0);
+    panic_if(max_size != INFINITE_, "Overflow of a flitBuffer of %d flits, "
+             "flow control let in more flits than it can hold.", max_size);
+    resize(2 * m_buffer.size());
 }
 
 bool
 flitBuffer::isReady(Tick curTime)
 {
-    if (m_buffer.size() != 0 ) {
+    if (!isEmpty()) {
         flit *t_flit = peekTopFlit();
         if (t_flit->get_time() <= curTime)
             return true;
@@ -70,27 +103,29 @@ flitBuffer::isReady(Tick curTime)
 void
 flitBuffer::print(std::ostream& out) const
 {
-    out << "[flitBuffer: " << m_buffer.size() << "] " << std::endl;
+    out << "[flitBuffer: " << getSize() << "] " << std::endl;
 }
 
 bool
 flitBuffer::isFull()
 {
-    return (m_buffer.size() >= max_size);
+    return (getSize() >= max_size);
 }
 
 void
 flitBuffer::setMaxSize(int maximum)
 {
+    assert(maximum > 0 && maximum >= getSize());
     max_size = maximum;
+    resize(std::max(maximum, getSize()));
 }
 
 bool
 flitBuffer::functionalRead(Packet *pkt, WriteMask &mask)
 {
     bool read = false;
-    for (unsigned int i = 0; i < m_buffer.size(); ++i) {
-        if (m_buffer[i]->functionalRead(pkt, mask)) {
+    for (uint32_t i = m_head; i != m_tail; i++) {
+        if (m_buffer[i & m_mask]->functionalRead(pkt, mask)) {
             read = true;
         }
     }
@@ -103,8 +138,8 @@ flitBuffer::functionalWrite(Packet *pkt)
 {
     uint32_t num_functional_writes = 0;
 
-    for (unsigned int i = 0; i < m_buffer.size(); ++i) {
-        if (m_buffer[i]->functionalWrite(pkt)) {
+    for (uint32_t i = m_head; i != m_tail; i++) {
+        if (m_buffer[i & m_mask]->functionalWrite(pkt)) {
             num_functional_writes++;
         }
     }
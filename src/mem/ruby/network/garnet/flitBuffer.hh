@@ -32,6 +32,8 @@
 #define __MEM_RUBY_NETWORK_GARNET_0_FLITBUFFER_HH__
 
 #include <algorithm>
+#include <cassert>
+#include <cstdint>
 #include <iostream>
 #include <vector>
 
@@ -47,6 +49,11 @@ namespace ruby
 namespace garnet
 {
 
+// FIFO of flits in a ring of power-of-two size. A buffer with a maximum
+// size (e.g., an input VC, whose depth is buffers_per_data_vc or
+// buffers_per_ctrl_vc) never grows, and inserting into it when full is an
+// error: credit-based flow control overran it. Buffers without a maximum
+// size (links, network interface queues) double their ring when full.
 class flitBuffer
 {
   public:
@@ -54,37 +61,49 @@ class flitBuffer
     flitBuffer(int maximum_size);
 
     bool isReady(Tick curTime);
-    bool isEmpty();
+    bool isEmpty() { return m_head == m_tail; }
     void print(std::ostream& out) const;
     bool isFull();
     void setMaxSize(int maximum);
-    int getSize() const { return m_buffer.size(); }
+    int getSize() const { return m_tail - m_head; }
 
     flit *
     getTopFlit()
     {
-        flit *f = m_buffer.front();
-        m_buffer.pop_front();
-        return f;
+        assert(!isEmpty());
+        return m_buffer[m_head++ & m_mask];
     }
 
     flit *
     peekTopFlit()
     {
-        return m_buffer.front();
+        assert(!isEmpty());
+        return m_buffer[m_head & m_mask];
     }
 
     void
     insert(flit *flt)
     {
-        m_buffer.push_back(flt);
+        if (getSize() == m_limit)
+            makeRoom();
+        m_buffer[m_tail++ & m_mask] = flt;
     }
 
     bool functionalRead(Packet *pkt, WriteMask &mask);
     uint32_t functionalWrite(Packet *pkt);
 
   private:
-    std::deque<flit *> m_buffer;
+    void resize(int size);
+    void makeRoom();
+
+    // Flits are at m_buffer[i & m_mask] for i in [m_head, m_tail)
+    std::vector<flit *> m_buffer;
+    uint32_t m_mask;
+    uint32_t m_head;
+    uint32_t m_tail;
+    // Number of flits the ring takes before makeRoom() is called: the
+    // maximum size, or the ring size for a buffer without maximum
+    int m_limit;
     int max_size;
 };
 
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2026 The gem5 contributors
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met: redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer;
+ * redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution;
+ * neither the name of the copyright holders nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <gtest/gtest.h>
+
+#include <deque>
+
+#include "base/gtest/logging.hh"
+#include "mem/ruby/network/garnet/flit.hh"
+#include "mem/ruby/network/garnet/flitBuffer.hh"
+
+using namespace gem5;
+using namespace gem5::ruby::garnet;
+
+namespace
+{
+
+// The flits of the tests are only compared by address, and arrive at the
+// time given by their id
+struct Flits
+{
+    std::deque<flit> flits;
+
+    flit *
+    make(int id)
+    {
+        return &flits.emplace_back(0, id, 0, 0, RouteInfoPtr(),
+                                   1, ruby::MsgPtr(), 0, 128, Tick(id));
+    }
+};
+
+} // anonymous namespace
+
+/** The flits of a buffer without maximum leave in order as it grows. */
+TEST(FlitBufferTest, GrowsInOrder)
+{
+    Flits f;
+    flitBuffer buffer;
+    std::vector<flit *> in;
+
+    // Interleave removals with the insertions so the ring wraps around
+    // before each growth
+    int out = 0;
+    for (int i = 0; i < 100; i++) {
+        in.push_back(f.make(i));
+        buffer.insert(in.back());
+        if (i % 3 == 2) {
+            ASSERT_EQ(buffer.getTopFlit(), in[out++]);
+        }
+        ASSERT_EQ(buffer.getSize(), in.size() - out);
+    }
+    ASSERT_FALSE(buffer.isFull());
+
+    while (!buffer.isEmpty()) {
+        ASSERT_EQ(buffer.peekTopFlit(), in[out]);
+        ASSERT_EQ(buffer.getTopFlit(), in[out++]);
+    }
+    ASSERT_EQ(out, in.size());
+}
+
+/** A buffer with a maximum wraps around at that size without growing. */
+TEST(FlitBufferTest, BoundedWrapsAround)
+{
+    Flits f;
+    flitBuffer buffer(5);
+    std::deque<flit *> in;
+
+    for (int i = 0; i < 50; i++) {
+        while (!buffer.isFull()) {
+            in.push_back(f.make(i));
+            buffer.insert(in.back());
+        }
+        ASSERT_EQ(buffer.getSize(), 5);
+
+        for (int j = 0; j <= i % 5; j++) {
+            ASSERT_EQ(buffer.getTopFlit(), in.front());
+            in.pop_front();
+        }
+    }
+}
+
+/** Inserting into a full buffer with a maximum is an error. */
+TEST(FlitBufferTest, Overflow)
+{
+    Flits f;
+    flitBuffer buffer(3);
+
+    for (int i = 0; i < 3; i++)
+        buffer.insert(f.make(i));
+    ASSERT_TRUE(buffer.isFull());
+
+    gtestLogOutput.str("");
+    EXPECT_ANY_THROW(buffer.insert(f.make(3)));
+    EXPECT_NE(gtestLogOutput.str().find("Overflow of a flitBuffer of 3"),
+              std::string::npos);
+}
+
+/** The buffer is ready once the time of its top flit is reached. */
+TEST(FlitBufferTest, Ready)
+{
+    Flits f;
+    flitBuffer buffer;
+
+    ASSERT_FALSE(buffer.isReady(100));
+    buffer.insert(f.make(10));
+    buffer.insert(f.make(5));
+    ASSERT_FALSE(buffer.isReady(9));
+    ASSERT_TRUE(buffer.isReady(10));
+
+    // Only the top flit counts
+    buffer.getTopFlit();
+    ASSERT_TRUE(buffer.isReady(5));
+    buffer.getTopFlit();
+    ASSERT_FALSE(buffer.isReady(100));
+}
@@ -0,0 +1,98 @@
+# Copyright (c) 2026 The gem5 contributors
+# All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met: redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer;
+# redistributions in binary form must reproduce the above copyright
+# notice, this list of conditions and the following disclaimer in the
+# documentation and/or other materials provided with the distribution;
+# neither the name of the copyright holders nor the names of its
+# contributors may be used to endorse or promote products derived from
+# this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+# LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+# DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+# THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+# (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+# OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+"""
+Runs garnet synthetic traffic and drains the system every --drain-interval
+ticks. The network only reports itself drained once it holds no packet, so
+every drain has to complete while the traffic injectors hold off, and the
+packets in flight must all be delivered.
+"""
+
+import argparse
+
+import m5
+from m5.objects import *
+
+m5.util.addToPath("../../../configs/")
+from common import Options
+from ruby import Ruby
+
+parser = argparse.ArgumentParser()
+Options.addNoISAOptions(parser)
+Ruby.define_options(parser)
+parser.add_argument(
+    "-i", "--injectionrate", type=float, default=0.3, metavar="I"
+)
+parser.add_argument("--sim-cycles", type=int, default=1000000)
+parser.add_argument("--drain-interval", type=int, default=100000)
+
+args = parser.parse_args()
+
+cpus = [
+    GarnetSyntheticTraffic(
+        sim_cycles=args.sim_cycles,
+        inj_rate=args.injectionrate,
+        num_dest=args.num_dirs,
+    )
+    for i in range(args.num_cpus)
+]
+
+system = System(cpu=cpus, mem_ranges=[AddrRange(args.mem_size)])
+system.voltage_domain = VoltageDomain(voltage=args.sys_voltage)
+system.clk_domain = SrcClockDomain(
+    clock=args.sys_clock, voltage_domain=system.voltage_domain
+)
+
+Ruby.create_system(args, False, system)
+system.ruby.clk_domain = SrcClockDomain(
+    clock=args.ruby_clock, voltage_domain=system.voltage_domain
+)
+
+for cpu, ruby_port in zip(cpus, system.ruby._cpu_ports):
+    cpu.test = ruby_port.in_ports
+
+root = Root(full_system=False, system=system)
+root.system.mem_mode = "timing"
+
+m5.ticks.setGlobalFrequency("500ps")
+m5.instantiate()
+
+# Drain well before the testers complete, as m5.drain() would swallow
+# their exit event
+num_drains = 0
+while m5.curTick() + 2 * args.drain_interval < args.sim_cycles:
+    exit_event = m5.simulate(args.drain_interval)
+    if exit_event.getCause() != "simulate() limit reached":
+        break
+    m5.drain()
+    num_drains += 1
+else:
+    exit_event = m5.simulate()
+
+print(
+    f"Exiting @ tick {m5.curTick()} because {exit_event.getCause()}"
+    f" after {num_drains} drains"
+)
@@ -29,7 +29,12 @@ Test file for simple memory test
 TODO: Add stats checking
 """
 
+import re
+import sys
+
 from testlib import *
+from testlib import test_util
+from testlib.helper import log_call
 
 gem5_verify_config(
     name="simple_mem_default",
@@ -137,3 +142,191 @@ for test_name, basename_noext, args in null_tests:
         valid_hosts=constants.supported_hosts,
         length=constants.long_tag,
     )
+
+# The garnet configurations must also deliver packets through the network
+garnet_received = verifier.MatchFileRegex(
+    r"^system\.ruby\.network\.packets_received::total\s+[1-9]",
+    [constants.gem5_simulation_stats],
+)
+
+garnet_tests = [
+    (
+        "ruby_mem_test-garnet-serdes",
+        "ruby_mem_test",
+        [
+            "--abs-max-tick",
+            "20000000",
+            "--network=garnet",
+            "--topology=HeteroMesh_XY",
+            "--mesh-rows=2",
+            "--num-cpus=4",
+            "--num-dirs=4",
+        ],
+    ),
+    (
+        "garnet_synth_traffic-vct",
+        "garnet_synth_traffic",
+        [
+            "--sim-cycles",
+            "5000000",
+            "--network=garnet",
+            "--virtual-cut-through",
+            "--buffers-per-data-vc=5",
+        ],
+    ),
+    (
+        "garnet_synth_traffic-islip",
+        "garnet_synth_traffic",
+        [
+            "--sim-cycles",
+            "5000000",
+            "--network=garnet",
+            "--sa-policy=islip",
+        ],
+    ),
+    (
+        "garnet_synth_traffic-wavefront",
+        "garnet_synth_traffic",
+        [
+            "--sim-cycles",
+            "5000000",
+            "--network=garnet",
+            "--sa-policy=wavefront",
+        ],
+    ),
+    (
+        "ruby_mem_test-garnet-multicast",
+        "ruby_mem_test",
+        [
+            "--abs-max-tick",
+            "20000000",
+            "--network=garnet",
+            "--multicast",
+            "--num-cpus=4",
+        ],
+    ),
+]
+
+for test_name, basename_noext, args in garnet_tests:
+    gem5_verify_config(
+        name=test_name,
+        fixtures=(),
+        verifiers=(garnet_received,),
+        config=joinpath(
+            config.base_dir, "configs", "example", basename_noext + ".py"
+        ),
+        config_args=args,
+        valid_isas=(constants.null_tag,),
+        valid_hosts=constants.supported_hosts,
+        length=constants.long_tag,
+    )
+
+# Every drain must complete, with all the packets in flight delivered
+gem5_verify_config(
+    name="garnet_synth_traffic-drain",
+    fixtures=(),
+    verifiers=(
+        garnet_received,
+        verifier.MatchRegex(
+            r"because Network Tester completed simCycles after [1-9]",
+            match_stderr=False,
+        ),
+    ),
+    config=joinpath(getcwd(), "garnet-drain-run.py"),
+    config_args=[
+        "--network=garnet",
+        "--num-cpus=16",
+        "--num-dirs=16",
+        "--topology=Mesh_XY",
+        "--mesh-rows=4",
+    ],
+    valid_isas=(constants.null_tag,),
+    valid_hosts=constants.supported_hosts,
+    length=constants.long_tag,
+)
+
+
+class MatchSingleThreadStats(verifier.Verifier):
+    """
+    Runs the config of the test again with the garnet network on a single
+    thread, and checks that it simulates the same as on several threads.
+    Only the stats measuring the host may differ.
+    """
+
+    _ignore_regex = re.compile(
+        r"^(host|.*\.(routing_table_build_time|flit_pool_slab_allocs)\s)"
+    )
+
+    def __init__(self, config, config_args):
+        super().__init__()
+        self.config = config
+        self.config_args = config_args
+
+    def _stats(self, fname):
+        with open(fname, "r") as file_:
+            return [
+                line.split("#")[0].split()
+                for line in file_
+                if not self._ignore_regex.match(line)
+            ]
+
+    def test(self, params):
+        fixtures = params.fixtures
+        tempdir = fixtures[constants.tempdir_fixture_name].path
+        gem5 = fixtures[constants.gem5_binary_fixture_name].path
+        single_dir = joinpath(tempdir, "single-thread")
+
+        command = [gem5, "-d", single_dir, "-re", "--silent-redirect"]
+        command.append(self.config)
+        command.extend(self.config_args)
+        command.append("--garnet-threads=1")
+        log_call(
+            params.log,
+            command,
+            time=params.time,
+            stdout=sys.stdout,
+            stderr=sys.stderr,
+        )
+
+        stats_file = constants.gem5_simulation_stats
+        if self._stats(joinpath(tempdir, stats_file)) != self._stats(
+            joinpath(single_dir, stats_file)
+        ):
+            test_util.fail(
+                "The stats differ between one and several garnet threads."
+            )
+
+
+# A garnet network split into regions must simulate the same whatever the
+# number of threads running them
+garnet_threads_config = joinpath(
+    config.base_dir, "configs", "example", "garnet_synth_traffic.py"
+)
+garnet_threads_args = [
+    "--sim-cycles",
+    "1000000",
+    "--network=garnet",
+    "--topology=Mesh_XY",
+    "--mesh-rows=2",
+    "--num-cpus=4",
+    "--num-dirs=4",
+    "--injectionrate=0.2",
+    "--garnet-regions=4",
+]
+
+gem5_verify_config(
+    name="garnet_synth_traffic-threads",
+    fixtures=(),
+    verifiers=(
+        garnet_received,
+        MatchSingleThreadStats(
+            garnet_threads_config,
+            garnet_threads_args,
+        ),
+    ),
+    config=garnet_threads_config,
+    config_args=garnet_threads_args + ["--garnet-threads=4"],
+    valid_isas=(constants.null_tag,),
+    valid_hosts=constants.supported_hosts,
+    length=constants.long_tag,
+)